@@ -32,11 +32,105 @@
 //--------------------------------------------------------------------------------------------------
 
 #include <assert.h>
+#include <stdint.h>
 #include "blocklist.h"
 
+//
+// The blocks are kept in a doubly-linked list sorted by ptr (for ordered iteration) and indexed by
+// a radix tree over the bits of ptr (for lookups). The tree has RADIX_LEVELS levels of nodes with
+// 2^RADIX_BITS children each; a bitmap per node records which children exist and a counter the
+// number of blocks in the subtree. The children of the last level are the Blocks themselves.
+//
+// With a fixed key width, the tree depth is constant, so
+//   - find_block() descends the tree,
+//   - insert_block() finds its predecessor in the list with the bitmaps on the path (the largest
+//     set bit below the key's digit) and splices the new block in after it,
+//   - delete_block() unlinks the block and clears the path bottom-up,
+//   - find_block_by_index() skips entire subtrees using their counters, and
+//   - num_blocks() returns a counter
+// in constant time (bounded by RADIX_LEVELS * 2^RADIX_BITS steps).
+//
+// The same ptr may be inserted more than once. Duplicates are adjacent in the list; the leaf slot
+// points to the last of them so that new duplicates are appended as before.
+//
+
+#define RADIX_BITS   6
+#define RADIX_FANOUT (1 << RADIX_BITS)
+#define RADIX_LEVELS ((64 + RADIX_BITS - 1) / RADIX_BITS)
+#define RADIX_MASK   (RADIX_FANOUT - 1)
+
+/// @brief digit of @a key at tree level @a level (0 = root)
+#define DIGIT(key, level) (((key) >> ((RADIX_LEVELS - 1 - (level)) * RADIX_BITS)) & RADIX_MASK)
+
+/// @brief radix tree node
+typedef struct __rnode {
+  uint64_t        bitmap;               ///< bit i set iff child[i] exists
+  size_t          count;                ///< number of blocks in subtree
+  void            *child[RADIX_FANOUT]; ///< child nodes or Blocks (last level)
+} RNode;
+
 Block *head = NULL;
 Block *tail = NULL;
 
+static RNode *root = NULL;              ///< radix tree root
+static size_t nblocks = 0;              ///< number of blocks in list
+
+
+/// @brief index of highest set bit in @a bitmap (bitmap != 0)
+static inline int highest_bit(uint64_t bitmap)
+{
+  return 63 - __builtin_clzll(bitmap);
+}
+
+/// @brief last (largest) Block in subtree @a n at level @a level
+static Block* max_block(RNode *n, int level)
+{
+  for (; level < RADIX_LEVELS - 1; level++) n = n->child[highest_bit(n->bitmap)];
+  return n->child[highest_bit(n->bitmap)];
+}
+
+/// @brief last Block with a ptr smaller than @a key in subtree @a n at level @a level
+static Block* pred_block(RNode *n, int level, uintptr_t key)
+{
+  int d = DIGIT(key, level);
+
+  if ((level < RADIX_LEVELS - 1) && (n->bitmap & (1ULL << d))) {
+    Block *b = pred_block(n->child[d], level + 1, key);
+    if (b != NULL) return b;
+  }
+
+  uint64_t lower = n->bitmap & ((1ULL << d) - 1);
+  if (lower == 0) return NULL;
+  if (level == RADIX_LEVELS - 1) return n->child[highest_bit(lower)];
+  return max_block(n->child[highest_bit(lower)], level + 1);
+}
+
+/// @brief leaf slot of @a key, NULL if it does not exist
+static Block** leaf_slot(uintptr_t key)
+{
+  RNode *n = root;
+  for (int level = 0; level < RADIX_LEVELS - 1; level++) {
+    int d = DIGIT(key, level);
+    if (!(n->bitmap & (1ULL << d))) return NULL;
+    n = n->child[d];
+  }
+
+  int d = DIGIT(key, RADIX_LEVELS - 1);
+  return (n->bitmap & (1ULL << d)) ? (Block**)&n->child[d] : NULL;
+}
+
+/// @brief free subtree @a n at level @a level
+static void free_tree(RNode *n, int level)
+{
+  if (level < RADIX_LEVELS - 1) {
+    for (uint64_t m = n->bitmap; m != 0; m &= m - 1) {
+      free_tree(n->child[__builtin_ctzll(m)], level + 1);
+    }
+  }
+  free(n);
+}
+
+
 void init_blocklist(void)
 {
   if (head != NULL) free_blocklist();
@@ -59,6 +153,9 @@ void init_blocklist(void)
   // always holds.
   head->ptr  = NULL;
   tail->ptr  = (void*)-1;
+
+  root = calloc(1, sizeof(RNode));
+  nblocks = 0;
 }
 
 void free_blocklist(void)
@@ -70,6 +167,10 @@ void free_blocklist(void)
     b = next;
   }
   head = tail = NULL;
+
+  if (root != NULL) free_tree(root, 0);
+  root = NULL;
+  nblocks = 0;
 }
 
 Block* insert_block(void *ptr, size_t size, int flags)
@@ -77,20 +178,60 @@ Block* insert_block(void *ptr, size_t size, int flags)
   assert(head != NULL);
   assert((ptr != NULL) && (ptr != (void*)-1));
 
+  uintptr_t key = (uintptr_t)ptr;
+  RNode *path[RADIX_LEVELS];
+  RNode *n = root;
+
   Block *b = calloc(1, sizeof(Block));
-  if (b != NULL) {
-    b->ptr = ptr;
-    b->size = size;
-    b->flags = flags;
-
-    Block *s = head;
-    while (s->ptr <= ptr) s = s->next;
-
-    b->next = s;
-    b->prev = s->prev;
-    s->prev = b;
-    b->prev->next = b;
+  if (b == NULL) return NULL;
+
+  // follow the existing part of the path to the leaf
+  int level = 0;
+  while ((level < RADIX_LEVELS - 1) && (n->bitmap & (1ULL << DIGIT(key, level)))) {
+    path[level] = n;
+    n = n->child[DIGIT(key, level)];
+    level++;
+  }
+  path[level] = n;
+
+  // allocate the missing nodes before linking any of them, so that a failure leaves the tree
+  // unchanged
+  for (int l = level + 1; l < RADIX_LEVELS; l++) {
+    path[l] = calloc(1, sizeof(RNode));
+    if (path[l] == NULL) {
+      while (--l > level) free(path[l]);
+      free(b);
+      return NULL;
+    }
   }
+  for (int l = level; l < RADIX_LEVELS - 1; l++) {
+    int d = DIGIT(key, l);
+    path[l]->child[d] = path[l + 1];
+    path[l]->bitmap |= 1ULL << d;
+  }
+  n = path[RADIX_LEVELS - 1];
+
+  b->ptr = ptr;
+  b->size = size;
+  b->flags = flags;
+
+  // insert after the last block with the same ptr or, if none, after the predecessor
+  int d = DIGIT(key, RADIX_LEVELS - 1);
+  Block *s;
+  if (n->bitmap & (1ULL << d)) s = n->child[d];
+  else s = pred_block(root, 0, key);
+  if (s == NULL) s = head;
+  s = s->next;
+
+  b->next = s;
+  b->prev = s->prev;
+  s->prev = b;
+  b->prev->next = b;
+
+  n->child[d] = b;
+  n->bitmap |= 1ULL << d;
+  for (int l = 0; l < RADIX_LEVELS; l++) path[l]->count++;
+  nblocks++;
 
   return b;
 }
@@ -100,23 +241,43 @@ Block* find_block(void *ptr)
   assert(head != NULL);
   assert((ptr != NULL) && (ptr != (void*)-1));
 
-  Block *b = head;
-  while (b->ptr < ptr) b = b->next;
+  Block **slot = leaf_slot((uintptr_t)ptr);
+  if (slot == NULL) return NULL;
 
-  return b->ptr == ptr ? b : NULL;
+  // return the first of several blocks with the same ptr
+  Block *b = *slot;
+  while (b->prev->ptr == ptr) b = b->prev;
+
+  return b;
 }
 
 Block* find_block_by_index(size_t idx)
 {
   assert(head != NULL);
 
-  Block *b = head->next;
-  while ((b != tail) && (idx > 0)) {
+  if (idx >= nblocks) return NULL;
+
+  // skip subtrees down to the leaf node containing the idx-th block
+  RNode *n = root;
+  for (int level = 0; level < RADIX_LEVELS - 1; level++) {
+    RNode *c = NULL;
+    for (uint64_t m = n->bitmap; m != 0; m &= m - 1) {
+      c = n->child[__builtin_ctzll(m)];
+      if (idx < c->count) break;
+      idx -= c->count;
+    }
+    n = c;
+  }
+
+  // walk the list from the first block of the leaf node
+  Block *b = n->child[__builtin_ctzll(n->bitmap)];
+  while (b->prev->ptr == b->ptr) b = b->prev;
+  while (idx > 0) {
     b = b->next;
     idx--;
   }
 
-  return b != tail ? b : NULL;
+  return b;
 }
 
 int delete_block(void *ptr)
@@ -124,14 +285,41 @@ int delete_block(void *ptr)
   assert(head != NULL);
   assert((ptr != NULL) && (ptr != (void*)-1));
 
-  Block *b = find_block(ptr);
-  if (b != NULL) {
-    b->prev->next = b->next;
-    b->next->prev = b->prev;
-    free(b);
+  uintptr_t key = (uintptr_t)ptr;
+  RNode *path[RADIX_LEVELS];
+  RNode *n = root;
+
+  for (int level = 0; level < RADIX_LEVELS - 1; level++) {
+    int d = DIGIT(key, level);
+    if (!(n->bitmap & (1ULL << d))) return 0;
+    path[level] = n;
+    n = n->child[d];
+  }
+  path[RADIX_LEVELS - 1] = n;
+
+  int d = DIGIT(key, RADIX_LEVELS - 1);
+  if (!(n->bitmap & (1ULL << d))) return 0;
+
+  // delete the first of several blocks with the same ptr; the slot points to the last one
+  Block *b = n->child[d];
+  while (b->prev->ptr == ptr) b = b->prev;
+  if (b == n->child[d]) n->bitmap &= ~(1ULL << d);
+
+  b->prev->next = b->next;
+  b->next->prev = b->prev;
+  free(b);
+  nblocks--;
+
+  // update counters and release empty nodes bottom-up
+  for (int level = RADIX_LEVELS - 1; level >= 0; level--) {
+    path[level]->count--;
+    if ((level > 0) && (path[level]->count == 0)) {
+      free(path[level]);
+      path[level - 1]->bitmap &= ~(1ULL << DIGIT(key, level - 1));
+    }
   }
 
-  return b != NULL;
+  return 1;
 }
 
 const Block* first_block(void)
@@ -170,22 +358,13 @@ size_t num_blocks(void)
 {
   assert(head != NULL);
 
-  size_t res = 0;
-  Block *b = head->next;
-
-  while (b != tail) {
-    b = b->next;
-    res++;
-  }
-
-  return res;
+  return nblocks;
 }
 
 Block** get_block_array(void)
 {
   assert(head != NULL);
 
-  size_t nblocks = num_blocks();
   Block **res = (Block**)calloc(nblocks+1, sizeof(Block*));
 
   if (res != NULL) {
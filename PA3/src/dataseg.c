@@ -62,25 +62,52 @@
 // (i.e., to ds_start + PAGESIZE).
 //
 // The heap size can be adjusted by calling ds_sbrk(). The memory protection flags are set 
-// automatically whenever the ds_heap_brk pointer is adjusted.
+// automatically whenever the ds_heap_brk pointer is adjusted. Only the pages between the old and
+// the new brk change their protection, so the cost of ds_sbrk() does not depend on the size of
+// the heap. Pages released by a negative increment are returned to the kernel (MADV_DONTNEED),
+// so the resident size shrinks with the heap. With ds_setmprotect(0), the entire heap area is
+// accessible and ds_sbrk() does not call mprotect() at all.
 //
 // ds_heap_stat() can be used to retrieve information about the heap area.
 //
 // ds_release() releases all memory and resets all internal variables. A subsequent call to
 // ds_allocate() is supported and initializes a 'fresh' heap.
 //
+// Reservation:
+// ------------
+// By default, the data segment is mapped with MAP_POPULATE. With ds_setlazy(1), it is only
+// reserved (MAP_NORESERVE): no swap space is committed and pages are faulted in on first access
+// as the brk advances, so that a large data segment costs nothing at startup. With
+// ds_sethugepages(1), the heap starts on a huge page boundary and is marked MADV_HUGEPAGE so
+// that the kernel can back it with transparent huge pages. ds_getrss() reports how much of the
+// data segment is resident.
+//
+// Large objects:
+// --------------
+// Large objects can be placed outside the data segment in separate anonymous mappings obtained
+// with ds_mmap(). ds_mremap() resizes a mapping (moving it in the address space without copying
+// if necessary), ds_munmap() releases it. ds_mmap_stat() reports the number and total size of
+// the live mappings. These functions are thread-safe and independent of ds_allocate()/
+// ds_release().
+//
+
+#define _GNU_SOURCE
 
 #include <assert.h>
 #include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
 #include "dataseg.h"
 
+#define HUGEPAGESIZE (2UL << 20)    ///< transparent huge page size
+#define PAGE_UP(p)   ((void*)(((uintptr_t)(p) + PAGESIZE - 1) & ~((uintptr_t)PAGESIZE - 1))) ///< page boundary at/above p
+
 
 static void *ds_start = NULL;       ///< start of the data segment
 static void *ds_end   = NULL;       ///< end of the data segment
@@ -91,8 +118,12 @@ static int  PAGESIZE  = 0;          ///< (system) page size
 static int  ds_initialized = 0;     ///< initialized flag (yes: 1, otherwise 0)
 static int  ds_loglevel    = 0;     ///< log level (0: off; 1: info; 2: verbose)
 static int  ds_domprotect  = 1;     ///< mprotect() heap areas (0: off, 1: on)
+static int  ds_lazy        = 0;     ///< reserve data segment without populating it (0: off, 1: on)
+static int  ds_hugepages   = 0;     ///< back heap with transparent huge pages (0: off, 1: on)
 static ssize_t ds_num_sbrk = 0;     ///< number of times ds_sbrk() was called with a non-zero 
                                     ///< argument
+static size_t ds_num_mmap  = 0;     ///< number of live ds_mmap() mappings
+static size_t ds_mmap_size = 0;     ///< total size of live ds_mmap() mappings
 
 
 /// @brief print a log message if level <= ds_loglevel. The variadic argument is a printf format
@@ -122,6 +153,24 @@ static void ds_log(int level, ...)
   #define LOG(level, ...)
 #endif
 
+/// @brief set the access permissions of the pages from @a from to @a to (page-aligned)
+/// @param from start address
+/// @param to end address (nothing is done if @a to <= @a from)
+/// @param prot protection flags (see mprotect())
+static void ds_protect(void *from, void *to, int prot)
+{
+  if (to <= from) return;
+
+  LOG(2, "  setting memory protection:\n"
+      "    %s from %p to %p\n", prot == PROT_NONE ? "NO ACCESS " : "READ/WRITE", from, to);
+
+  if (mprotect(from, to - from, prot) != 0) {
+    fprintf(stderr, "ERROR: cannot set memory protection flags in %s: %s.\n",
+        __func__, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+}
+
 void ds_allocate(size_t max_heap_size)
 {
   LOG(1, "ds_allocate(%lx)", max_heap_size);
@@ -131,14 +180,31 @@ void ds_allocate(size_t max_heap_size)
   PAGESIZE = getpagesize();
   size_t ds_size = max_heap_size + 2*PAGESIZE;
 
-  // allocate memory for the data segment
-  LOG(2, "  allocating %lx bytes of memory", ds_size);
-  ds_start = mmap(NULL, ds_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
-  if (ds_start == (void*)-1) {
+  // allocate memory for the data segment. With huge pages, map an extra huge page so that the
+  // heap can start on a huge page boundary
+  size_t slack = ds_hugepages ? HUGEPAGESIZE : 0;
+  int flags = MAP_PRIVATE|MAP_ANONYMOUS|(ds_lazy ? MAP_NORESERVE : MAP_POPULATE);
+
+  LOG(2, "  allocating %lx bytes of memory", ds_size + slack);
+  void *map = mmap(NULL, ds_size + slack, PROT_NONE, flags, -1, 0);
+  if (map == (void*)-1) {
     fprintf(stderr, "ERROR: cannot map memory in %s: %s.\n",
                     __func__, strerror(errno));
     exit(EXIT_FAILURE);
   }
+  ds_start = map;
+
+  if (ds_hugepages) {
+    // align the heap and return the unused head and tail of the mapping
+    ds_start = (void*)((((uintptr_t)map + PAGESIZE + slack - 1) & ~(slack - 1)) - PAGESIZE);
+    if (ds_start > map) munmap(map, ds_start - map);
+    if (map + slack > ds_start) munmap(ds_start + ds_size, map + slack - ds_start);
+
+    if (madvise(ds_start + PAGESIZE, max_heap_size, MADV_HUGEPAGE) != 0) {
+      fprintf(stderr, "WARNING: cannot enable huge pages in %s: %s.\n",
+                      __func__, strerror(errno));
+    }
+  }
 
   // try to lock the memory in RAM. Print only a warning if we don't succeed.
   /* don't do this for now. Requires changing resource limits in VM.
@@ -157,6 +223,9 @@ void ds_allocate(size_t max_heap_size)
   ds_initialized = 1;
   ds_num_sbrk    = 0;
 
+  // without memory protection, the entire heap area is accessible from the start
+  if (!ds_domprotect) ds_protect(ds_heap_start, ds_heap_end, PROT_READ|PROT_WRITE);
+
   LOG(2, "  ds_start:           %p\n"
          "  ds_heap_start:      %p\n"
          "  ds_heap_brk:        %p\n"
@@ -195,24 +264,18 @@ void* ds_sbrk(intptr_t increment)
     ds_num_sbrk++;
 
     if ((ds_heap_start <= ds_heap_brk) && (ds_heap_brk < ds_heap_end)) {
-      if (ds_domprotect) {
-        // adjust memory access permissions
-        // since we are not forcing alignment of brk at PAGESIZE, we need to mark the invalid part
-        // before allowing access to the permissible area because permissions are set on a page-level
-        // basis
-        LOG(2, "  setting memory protection:\n"
-            "    READ/WRITE from %p to %p\n"
-            "    NO ACCESS  from %p to %p\n",
-            ds_heap_start, ds_heap_brk, ds_heap_brk, ds_end);
-
-        void *aligned_brk = (void*)(((unsigned long)ds_heap_brk) / PAGESIZE * PAGESIZE); // round down
-
-        if ((mprotect(aligned_brk, ds_end-aligned_brk, PROT_NONE) != 0) ||
-            (mprotect(ds_heap_start, ds_heap_brk-ds_heap_start, PROT_READ|PROT_WRITE) != 0))
-        {
-          fprintf(stderr, "ERROR: cannot set memory protection flags in %s: %s.\n", 
-              __func__, strerror(errno));
-          exit(EXIT_FAILURE);
+      // the pages up to (and including) the page of the brk are accessible. Since permissions
+      // are set on a page-level basis, only the pages between the old and the new brk change
+      void *old_top = PAGE_UP(old_heap_brk), *new_top = PAGE_UP(ds_heap_brk);
+
+      if (new_top > old_top) {
+        if (ds_domprotect) ds_protect(old_top, new_top, PROT_READ|PROT_WRITE);
+      } else if (new_top < old_top) {
+        if (ds_domprotect) ds_protect(new_top, old_top, PROT_NONE);
+
+        // release the pages so that the resident size drops
+        if (madvise(new_top, old_top - new_top, MADV_DONTNEED) != 0) {
+          LOG(1, "  cannot release pages: %s", strerror(errno));
         }
       }
     } else {
@@ -249,6 +312,53 @@ ssize_t ds_getnsbrk(void)
   return ds_num_sbrk;
 }
 
+void* ds_mmap(size_t size)
+{
+  LOG(1, "ds_mmap(0x%lx)", size);
+
+  void *addr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) return (void*)-1;
+
+  __atomic_add_fetch(&ds_num_mmap, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&ds_mmap_size, size, __ATOMIC_RELAXED);
+
+  return addr;
+}
+
+
+void* ds_mremap(void *addr, size_t old_size, size_t new_size)
+{
+  LOG(1, "ds_mremap(%p, 0x%lx, 0x%lx)", addr, old_size, new_size);
+
+  void *new_addr = mremap(addr, old_size, new_size, MREMAP_MAYMOVE);
+  if (new_addr == MAP_FAILED) return (void*)-1;
+
+  __atomic_add_fetch(&ds_mmap_size, new_size - old_size, __ATOMIC_RELAXED);
+
+  return new_addr;
+}
+
+
+int ds_munmap(void *addr, size_t size)
+{
+  LOG(1, "ds_munmap(%p, 0x%lx)", addr, size);
+
+  if (munmap(addr, size) != 0) return -1;
+
+  __atomic_sub_fetch(&ds_num_mmap, 1, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&ds_mmap_size, size, __ATOMIC_RELAXED);
+
+  return 0;
+}
+
+
+void ds_mmap_stat(size_t *nmaps, size_t *size)
+{
+  if (nmaps) *nmaps = __atomic_load_n(&ds_num_mmap, __ATOMIC_RELAXED);
+  if (size)  *size  = __atomic_load_n(&ds_mmap_size, __ATOMIC_RELAXED);
+}
+
+
 void ds_setloglevel(int level)
 {
   ds_loglevel = level;
@@ -257,7 +367,46 @@ void ds_setloglevel(int level)
 
 void ds_setmprotect(int active)
 {
-  ds_domprotect = (active > 0);
+  active = (active > 0);
+
+  // adjust the protection of the live data segment
+  if (ds_initialized && (active != ds_domprotect)) {
+    void *top = PAGE_UP(ds_heap_brk);
+    if (active) ds_protect(top, ds_heap_end, PROT_NONE);
+    else ds_protect(top, ds_heap_end, PROT_READ|PROT_WRITE);
+  }
+
+  ds_domprotect = active;
+}
+
+
+void ds_setlazy(int active)
+{
+  ds_lazy = (active > 0);
+}
+
+
+void ds_sethugepages(int active)
+{
+  ds_hugepages = (active > 0);
+}
+
+
+size_t ds_getrss(void)
+{
+  if (!ds_initialized) return 0;
+
+  // query the residency of the pages in chunks of sizeof(vec) pages
+  unsigned char vec[4096];
+  size_t pages = 0, chunk = sizeof(vec) * PAGESIZE;
+
+  for (void *p = ds_start; p < ds_end; p += chunk) {
+    size_t len = (size_t)(ds_end - p) < chunk ? (size_t)(ds_end - p) : chunk;
+    if (mincore(p, len, vec) != 0) return 0;
+    for (size_t i = 0; i < len / PAGESIZE; i++) pages += vec[i] & 1;
+  }
+
+  return pages * PAGESIZE;
 }
 
 
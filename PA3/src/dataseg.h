@@ -67,12 +67,53 @@ void ds_heap_stat(void **start, void **brk, void **end);
 /// @retval ssize_t number of sbrk() calls
 ssize_t ds_getnsbrk(void);
 
+/// @brief map @a size bytes of anonymous read/write memory outside the data segment
+/// @param size size of mapping in bytes (multiple of the page size)
+/// @retval page-aligned start address of mapping on success
+/// @retval (void*)-1 on error. errno is set by mmap()
+void* ds_mmap(size_t size);
+
+/// @brief resize a mapping obtained by ds_mmap(). The mapping may be moved without copying
+/// @param addr start address of mapping
+/// @param old_size current size of mapping in bytes
+/// @param new_size new size of mapping in bytes (multiple of the page size)
+/// @retval (possibly new) start address of mapping on success
+/// @retval (void*)-1 on error; the mapping is left untouched. errno is set by mremap()
+void* ds_mremap(void *addr, size_t old_size, size_t new_size);
+
+/// @brief release a mapping obtained by ds_mmap()
+/// @param addr start address of mapping
+/// @param size size of mapping in bytes
+/// @retval 0 on success
+/// @retval -1 on error. errno is set by munmap()
+int ds_munmap(void *addr, size_t size);
+
+/// @brief retrieve statistics about live ds_mmap() mappings
+/// @param[out] nmaps number of mappings
+/// @param[out] size  total size of mappings in bytes
+void ds_mmap_stat(size_t *nmaps, size_t *size);
+
 /// @brief set log level
 /// @brief level log level (0: no logging, 1: info; 2: verbose)
 void ds_setloglevel(int level);
 
-/// @brief turn mprotect() on/off
-/// @brief active (1: mprotect() activated, 0: mprotect() not executed)
+/// @brief turn mprotect() on/off. Can be called at any time.
+/// @brief active (1: only the heap up to the brk is accessible (default), 0: the entire heap area
+///        is accessible and mprotect() is not executed)
 void ds_setmprotect(int active);
 
+/// @brief select how the data segment is reserved. Must be called before ds_allocate().
+/// @param active (1: reserve with MAP_NORESERVE and fault pages in lazily as the brk advances,
+///               0: populate the mapping in ds_allocate() (default))
+void ds_setlazy(int active);
+
+/// @brief turn transparent huge pages for the heap on/off. Must be called before ds_allocate().
+/// @param active (1: align the heap to a huge page and mark it MADV_HUGEPAGE, 0: regular pages
+///               (default))
+void ds_sethugepages(int active);
+
+/// @brief retrieve the resident size of the data segment
+/// @retval number of bytes of the data segment that are resident in memory
+size_t ds_getrss(void);
+
 #endif // __DATSEG_H__
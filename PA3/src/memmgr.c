@@ -66,47 +66,496 @@
 // - block splitting: always at 32-byte boundaries
 // - immediate coalescing upon free
 //
+// Address-ordered free list:
+// --------------------------
+// - block layout identical to the explicit free list (h : n : p : ... : f)
+// - free blocks are kept in a NULL-terminated doubly-linked list sorted by address. Insertion
+//   starts at the list position of the most recently removed block (or the roving pointer) if it
+//   precedes the new block; split remainders and coalesced blocks thus return to their old
+//   position in O(1), other frees walk the list.
+// - allocation policy (selected with mm_init()):
+//   - fp_FirstFit: first block that fits, scanning from the lowest address
+//   - fp_NextFit:  first block that fits, scanning from a roving pointer that is left at the
+//                  position of the last allocation and wraps around at the end of the list
+//   - fp_BestFit:  smallest block that fits, lowest address on ties
+//   - fp_GoodFit:  first block that wastes at most mm_setgoodfit() percent of the request,
+//                  otherwise the best fit
+// - block splitting: always at 32-byte boundaries
+// - immediate coalescing upon free
+//
+// TLSF (two-level segregated fit):
+// --------------------------------
+// - block layout identical to the explicit free list (h : n : p : ... : f)
+// - free blocks are kept in segregated, NULL-terminated doubly-linked lists. The first level
+//   splits the size range into powers of two, the second level splits each power-of-two range
+//   into TLSF_SL_COUNT equally-sized classes. Blocks smaller than TLSF_SMALL are kept in linear
+//   classes of BS bytes each.
+// - one bitmap for the first level and one bitmap per first-level class record which lists are
+//   non-empty. Finding a free block is two find-first-set operations on these bitmaps.
+//
+//     size:  |<----------------- 2^fl ... 2^(fl+1)-1 ----------------->|
+//     sl:    |  0  |  1  |  2  |  3  |  ...                      | 15  |
+//
+// - allocation policy: good fit. The request is rounded up to the next class boundary so that any
+//   block in the selected list fits. Both allocation and free run in constant time.
+// - block splitting: always at 32-byte boundaries
+// - immediate coalescing upon free
+//
+// Free granule bitmap:
+// --------------------
+// - block layout identical to the implicit free list; free blocks carry no links
+// - a side bitmap (mapped outside the data segment) holds one bit per BS-byte granule of the heap,
+//   set if the granule belongs to a free block. Since free blocks are always coalesced, every run
+//   of set bits is exactly one free block and starts at its header. A summary bitmap with one bit
+//   per non-zero bitmap word lets the search skip fully allocated regions 64 words at a time.
+//
+//     heap:    | H | H |  h           f | H |  h   f | H | ...
+//     bitmap:    0   0    1  1  1  1  1   0    1  1   0
+//
+// - allocation policy: first fit. The search scans the bitmap a word at a time; words that
+//   cannot hold a long enough run are rejected with a population count, runs are found with
+//   count-trailing-zeroes. The result is the same block as an address-ordered first fit.
+// - low-water marks: for each power of two 2^c, gran_low[c] is a word below which no free block
+//   of at least 2^c granules starts. A search for k granules starts at gran_low[floor(log2 k)]
+//   instead of at word 0 and, when done, raises the marks of all classes with 2^c >= k to the
+//   word where it stopped. Freeing or coalescing a block lowers the marks of the classes that
+//   the block is large enough for. Splitting or shrinking a block never invalidates a mark, so
+//   the hot path of a malloc-heavy phase skips the fragmented low part of the heap.
+// - the bits change only when granules change state: place() clears the allocated granules,
+//   coalesce() sets the granules of the freed block. Updates thus cost O(size of the block
+//   allocated/freed), not O(size of the free block that is split or merged).
+// - block splitting: always at 32-byte boundaries
+// - immediate coalescing upon free
+//
+// Splay tree:
+// -----------
+// - minimal block size: 32 bytes (header + footer + left + right)
+// - l,r: left/right child in the tree
+//
+//               +---+---+---+-------------+---+
+//               | h | l | r :             : f |
+//               +---+---+---+-------------+---+
+//
+// - free blocks form a binary search tree ordered by (size, address). The tree is a top-down
+//   splay tree; it needs no parent pointer or balance information and thus fits into the two
+//   payload words of the smallest block. All operations run in amortized O(log n) time.
+// - allocation policy: exact best fit (smallest block that fits, lowest address on ties)
+// - block splitting: always at 32-byte boundaries
+// - immediate coalescing upon free
+//
+// Footerless allocated blocks:
+// ----------------------------
+// Bit 1 of every header (PREV_ALLOC) records whether the preceding block is allocated. Since
+// coalesce() only needs the footer of a free predecessor, footers of allocated blocks can be
+// omitted (mm_setfooter(0)). Free blocks always carry a footer. This applies to all policies.
+//
+//               +---+-----------------+---+---------------------+---+
+//               | H :                 | h :                   : f |
+//               +---+-----------------+---+---------------------+---+
+//                 ^                     ^
+//      PREV_ALLOC of predecessor    PREV_ALLOC = 1, ALLOC = 0
+//
+// - the overhead of an allocated block shrinks from 16 to 8 bytes
+// - the bit is maintained in both layouts; only the footer of allocated blocks is optional
+//
+// Slab front-end:
+// ---------------
+// With mm_setslab(1), requests of up to SLAB_MAX bytes are served from slab runs. A run is an
+// ordinary allocated block of SLAB_RUN_SIZE bytes (flag SLAB set in its header) that is cut
+// into equally-sized slots of one size class. Each slot is preceded by a tag word that is
+// written once when the run is created; the TAG bit distinguishes it from a block header.
+//
+//      run block
+//   +---+------------+---+--------+---+--------+-----       -----+---+
+//   | H | descriptor | t | object | t | object |  ...            : F |
+//   +---+------------+---+--------+---+--------+-----       -----+---+
+//                      ^
+//             tag: offset to H | TAG | TAG_SLAB
+//
+// - the descriptor holds the size class and a bitmap of free slots. Runs with free slots are
+//   kept in a doubly-linked list per size class.
+// - malloc/free of a small object only scans/updates the bitmap; no boundary tags are written.
+// - a run that becomes empty is returned to the heap unless it is the last run of its class.
+//
+// Thread-safe mode:
+// -----------------
+// All heap state lives in struct Arena. The functions below operate on the arena pointed to by
+// the thread-local variable 'arena'. In single-threaded mode (default), arenas[0] manages the
+// whole data segment and no locks are taken.
+//
+// With mm_setarenas(n), mm_init() grows the data segment once to its maximum size and carves it
+// into n page-aligned slices. Each slice is an independent arena with its own free lists and
+// lock; extend_heap() and heap shrinking move a per-arena break within the slice.
+//
+//   ds_heap_start                                                             ds_heap_end
+//   |                                                                                   |
+//   v                                                                                   v
+//   +--------------------+--------------------+-- ... --+--------------------+----------+
+//   | arena 0      :     | arena 1      :     |         | arena n-1    :     |  unused  |
+//   +--------------------+--------------------+-- ... --+--------------------+----------+
+//                  ^ brk                ^ brk                          ^ brk
+//
+// - threads are assigned a home arena round-robin. mm_malloc() locks the home arena (and falls
+//   back to the other arenas if the home arena is full). mm_free() locks the arena that owns the
+//   block, which is found from the block's address.
+// - a per-thread cache keeps up to TCACHE_FILL recently freed blocks of each size up to
+//   TCACHE_MAX bytes. Cached blocks remain allocated in their arena, so malloc/free of small
+//   blocks that hit the cache take no lock at all. The cache is flushed when the thread exits.
+// - blocks freed by a thread whose home arena is not the owner of the block are not freed under
+//   the owner's lock. Instead, they are pushed onto the owner's remote-free list with a single
+//   compare-and-swap. The list is a lock-free multi-producer/single-consumer stack linked through
+//   the first payload word. Whoever next locks the arena (usually the owner in mm_malloc())
+//   detaches the entire list with one atomic exchange and frees the blocks in a batch.
+// - like glibc, the allocator registers fork handlers (pthread_atfork()) when it first runs in
+//   thread-safe mode or creates a heap. Before fork(), the prepare handler locks every arena and
+//   heap, so that no other thread is in the middle of an operation when the address space is
+//   copied. The parent unlocks them afterwards; the child, whose only thread is the forking one,
+//   reinitializes the locks.
+//
+// Batch allocation:
+// -----------------
+// mm_malloc_batch() obtains a single block large enough for all n requests (one free-list
+// search and update) and carves it into n consecutive allocated blocks. mm_free_batch() sorts
+// the pointers by address, turns each run of physically adjacent blocks into one free block and
+// coalesces it once with its neighbors.
+//
+// Large objects:
+// --------------
+// With mm_setmmap(threshold), requests of threshold bytes or more are not served from the heap
+// but from a separate page-aligned mapping (ds_mmap()). The mapping starts with its size and a
+// tag of kind TAG_MMAP that precedes the payload:
+//
+//   mapping (multiple of PAGESIZE)
+//   +------+---+--------------------------------------------------+
+//   | size | t | payload                                          |
+//   +------+---+--------------------------------------------------+
+//   ^        ^
+//   |   tag: 8 | TAG | TAG_MMAP
+//   page-aligned
+//
+// - large objects neither pin the brk nor fragment the heap; freeing one unmaps it right away.
+// - mm_realloc() resizes a mapped object with ds_mremap(), which moves the pages in the address
+//   space if necessary instead of copying the payload.
+// - mapped objects do not belong to any arena and are handled before the arena is selected.
+//
+// Heap handles:
+// -------------
+// mm_heap_create() returns an isolated heap with its own policy. The heap is an ordinary arena
+// whose descriptor sits at the start of a private mapping; the rest of the mapping is the
+// arena's data segment, managed like a slice in thread-safe mode:
+//
+//   mapping (reserved with MAP_NORESERVE)
+//   +------------+----------------------------------------------------+
+//   | struct     | data segment                  :                    |
+//   | mm_heap    |                               ^ brk                |
+//   +------------+----------------------------------------------------+
+//   ^            ^                                                    ^
+//   heap handle  ds_heap_start                                        ds_heap_limit
+//
+// - the mm_heap_*() functions lock the heap, make its arena the current arena, and call the
+//   same arena functions as mm_malloc() & co. Heaps never hand out mmapped large objects, so
+//   the mapping holds all of a heap's memory and mm_heap_destroy() releases it with a single
+//   munmap() regardless of the number of live blocks.
+// - with 4-byte tags, links are relative to the start of the arena's data segment.
+// - each arena copies the footer, slab, and quick bin settings when it is initialized. A heap
+//   keeps the settings in effect when it was created; changing them later cannot corrupt the
+//   block layout of a heap that already holds blocks.
+//
+// Regions:
+// --------
+// A region (mm_region_create()) is a bump-pointer allocator layered on top of mm_malloc(). It
+// takes chunks of REGION_CHUNK bytes from the heap; the first one also holds the descriptor.
+//
+//     initial chunk                                     additional chunks
+//   +--------+-----------------------------------+    +------+--------------------------+
+//   | region | objects            :              | <- | next | objects        :         |
+//   +--------+-----------------------------------+    +------+--------------------------+
+//                                 ^ cur          ^ end                  (current chunk)
+//
+// - mm_region_alloc() rounds the bump pointer up to REGION_ALIGN and advances it; a new chunk is
+//   only allocated when the current one is exhausted. Requests larger than a quarter chunk get a
+//   chunk of their own so that the rest of the current chunk is not wasted.
+// - objects are never freed individually. mm_region_reset() returns all additional chunks with
+//   mm_free_batch(), REGION_BATCH at a time, and rewinds the bump pointer to the initial chunk.
+//
+// Heap growth and trimming:
+// -------------------------
+// The heap is grown and trimmed by a simple controller with four runtime knobs (mm_setgrowth(),
+// mm_settrim()). Each arena counts block allocations and frees (its 'clock').
+// - growth: the heap is extended by max(request, step). The step starts at mm_grow_min. If the
+//   heap has to be extended again within mm_trim_delay operations, the step is doubled, up to
+//   mm_grow_max and 1/2^GROW_SHIFT of the heap. Otherwise, it falls back to mm_grow_min.
+// - trimming: when the free block at the tail of the heap exceeds mm_trim_thld, the heap is
+//   trimmed to leave mm_trim_pad bytes of free space at the tail (hysteresis: the heap is only
+//   extended again after this slack is used up). No trimming happens within mm_trim_delay
+//   operations of the last extension, so an alloc/free pattern at the heap edge does not cause
+//   the data segment to grow and shrink on every call.
+//
+// Realloc:
+// --------
+// mm_realloc() grows a block in place whenever possible
+// - by merging it with a free successor,
+// - by extending the heap if the block (plus a free successor) is the last block in the heap, or
+// - by merging it with a free predecessor (and successor) and moving the payload backwards with
+//   memmove().
+// Only if all of these fail, the payload is copied to a new block.
+// Each arena remembers the last REALLOC_HIST blocks returned by mm_realloc(). A block that is
+// grown again is over-allocated by 50% (at most mm_grow_max bytes) so that vector-like
+// workloads with many small growth steps need only a logarithmic number of moves.
+//
+// Quick bins (deferred coalescing):
+// ---------------------------------
+// After mm_setquickbins(1), freed blocks of up to QUICK_MAX bytes are not coalesced but pushed
+// onto a LIFO quick bin for their exact size. They remain marked allocated, so neighbors do not
+// merge with them. A request for a block of that size pops the most recently freed block without
+// searching, splitting, or writing any boundary tags.
+// The quick bins are consolidated, i.e., all cached blocks are freed and coalesced in one sweep,
+// - when a request cannot be satisfied from the free list(s) before the heap is extended, or
+// - when the quick bins hold more than 1/2^QUICK_FRAG_SHIFT of the heap.
+//
+// Aligned allocation:
+// -------------------
+// Payloads of ordinary blocks start one word after the 32-byte aligned header and are thus only
+// 8-byte aligned. mm_memalign() places the header BS bytes (2*TYPE_SIZE bytes for 16-byte
+// alignment) before an aligned address and marks the word preceding the payload with a tag of
+// kind TAG_ALIGN that holds the offset to the header:
+//
+//     free block found for size + alignment - BS
+//   +---+-----------------+---+---+---+---+------------------------------+---+
+//   | h :   leading slack : f | H |   | t | payload                      : F |  (trailing slack)
+//   +---+-----------------+---+---+---+---+------------------------------+---+
+//                             ^           ^
+//                        32-byte aligned  aligned
+//
+// - place() splits the leading slack (a multiple of BS smaller than the alignment) into a free
+//   block of its own and the trailing slack as usual. No bytes other than the tag are wasted.
+// - free() and realloc() map the aligned payload back to the header with the tag. Aligned
+//   blocks are never served by the slab front-end or mmapped.
+//
+// Build variants:
+// ---------------
+// The block granule (BS) and the width of boundary tags and free list links (TYPE) are fixed at
+// compile time with MM_GRANULE and MM_TAG_SIZE. Each combination is compiled into a separate
+// object file exporting the same API; the Makefile builds the variant 'g16' next to the default.
+//
+//   variant   MM_GRANULE  MM_TAG_SIZE  min. block  heap size  payload alignment
+//   default       32           8        32 bytes   unlimited        8 bytes
+//   g16           16           4        16 bytes    < 4 GB         16 bytes
+//
+// - with 8-byte tags, links are pointers and block headers lie on the BS grid.
+// - with 4-byte tags, links are 32-bit offsets from the start of the data segment (0: NULL), and
+//   headers lie one tag before the BS grid so that payloads are BS-aligned:
+//
+//             BS grid         BS grid         BS grid
+//               |               |               |
+//           +---+---------------+---+-----------+---+
+//           | h : n : p   : f | H | payload   : F | H ...
+//           +---+---------------+---+-----------+---+
+//
+// - all layout decisions are constants, so there is no runtime branching on the variant.
+//
+// Heap verification:
+// ------------------
+// mm_verify() checks all invariants of the heap in one silent pass and returns the number of
+// violations: sentinels, block sizes, header/footer and prev-alloc bit consistency, no adjacent
+// free blocks, and the free list(s) against the heap walk. The splay tree is traversed in order
+// without a stack by temporarily threading it (Morris traversal); its order is checked as well.
+// In sampling mode (mm_setverify()), each arena verifies itself after every n-th operation,
+// either completely or in a window of a few blocks. The window starts at the block returned by
+// the sampled operation or, for frees, at the block that the freed block was coalesced into (or
+// the block pushed onto a quick bin). Only frees of slab objects fall back to a block taken from
+// the free structure (a random size class for TLSF, the start of the heap for the implicit
+// list). Thus the samples cover the parts of the heap that are being modified.
+//
 
 #define _GNU_SOURCE
 
 #include <assert.h>
+#include <errno.h>
 #include <error.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "dataseg.h"
 #include "memmgr.h"
 
 
+/// @name Build variant (see 'Build variants' above)
+/// @{
+#ifndef MM_GRANULE
+  #define MM_GRANULE       32                          ///< block granule in bytes (16, 32, or 64)
+#endif
+#ifndef MM_TAG_SIZE
+  #define MM_TAG_SIZE      8                           ///< boundary tag and free list link size (4 or 8)
+#endif
+
+#if (MM_GRANULE != 16) && (MM_GRANULE != 32) && (MM_GRANULE != 64)
+  #error "MM_GRANULE must be 16, 32, or 64"
+#endif
+#if (MM_TAG_SIZE != 4) && (MM_TAG_SIZE != 8)
+  #error "MM_TAG_SIZE must be 4 or 8"
+#endif
+#if 4*MM_TAG_SIZE > MM_GRANULE
+  #error "a free block (header, two links, footer) must fit into MM_GRANULE bytes"
+#endif
+
+#define MM_GRANULE_LOG2    (MM_GRANULE == 16 ? 4 : MM_GRANULE == 32 ? 5 : 6) ///< log2(MM_GRANULE)
+/// @}
+
+
 /// @name global variables
 /// @{
-static void *ds_heap_start = NULL;                     ///< physical start of data segment
-static void *ds_heap_brk   = NULL;                     ///< physical end of data segment
-static void *heap_start    = NULL;                     ///< logical start of heap
-static void *heap_end      = NULL;                     ///< logical end of heap
 static int  PAGESIZE       = 0;                        ///< memory system page size
-static void *(*get_free_block)(size_t) = NULL;         ///< get free block for selected allocation policy
-static size_t CHUNKSIZE    = 1<<16;                    ///< minimal data segment allocation unit
-static size_t SHRINKTHLD   = 1<<14;                    ///< threshold to shrink heap
+static size_t mm_grow_min  = 1<<16;                    ///< initial/minimal heap extension
+static size_t mm_grow_max  = 1<<22;                    ///< maximal heap extension step
+static size_t mm_trim_thld = 1<<17;                    ///< trim if free tail of heap exceeds this size
+static size_t mm_trim_pad  = 1<<16;                    ///< free space left at the tail after trimming
+static unsigned long mm_trim_delay = 256;              ///< pressure window/trim delay (in operations)
 static int  mm_initialized = 0;                        ///< initialized flag (yes: 1, otherwise 0)
 static int  mm_loglevel    = 0;                        ///< log level (0: off; 1: info; 2: verbose)
+static int  mm_footers     = 1;                        ///< footers on allocated blocks (yes: 1, no: 0)
+static int  mm_slab        = 0;                        ///< slab front-end for small requests (on: 1, off: 0)
+static int  mm_quick       = 0;                        ///< quick bins / deferred coalescing (on: 1, off: 0)
+static size_t mm_mmap_thld = 0;                        ///< requests >= this size are mmapped (0: off)
+static unsigned int mm_goodfit_tol = 25;                ///< good fit tolerance (in percent of the request)
+static unsigned long mm_verify_interval = 0;           ///< verify every n-th operation (0: off)
+static size_t mm_verify_window = 0;                    ///< blocks per verification sample (0: all)
+
+// TLSF
+#define TLSF_SL_LOG2       4                           ///< log2 of number of second-level classes
+#define TLSF_SL_COUNT      (1 << TLSF_SL_LOG2)         ///< number of second-level classes
+#define TLSF_FL_SHIFT      (TLSF_SL_LOG2 + MM_GRANULE_LOG2) ///< log2(TLSF_SL_COUNT * BS)
+#define TLSF_SMALL         (1UL << TLSF_FL_SHIFT)      ///< blocks below this size use linear classes
+#define TLSF_FL_COUNT      (64 - TLSF_FL_SHIFT + 1)    ///< number of first-level classes
+
+// Slab front-end
+#define SLAB_MAX           256                         ///< largest request served by slab runs
+#define SLAB_ALIGN         16                          ///< slot size granularity
+#define SLAB_CLASSES       ((SLAB_MAX + 8) / SLAB_ALIGN + 1) ///< number of slab size classes
+#define SLAB_RUN_SIZE      4096                        ///< block size of a slab run
+#define SLAB_MAP_WORDS     4                           ///< words in free slot bitmap of a run
+
+// Heap growth
+#define GROW_SHIFT         4                           ///< growth step is at most heap/16
+
+// Realloc
+#define REALLOC_HIST       4                           ///< number of recently reallocated blocks
+
+// Quick bins
+#define QUICK_MAX          256                         ///< largest block size kept in quick bins
+#define QUICK_BINS         (QUICK_MAX / MM_GRANULE)    ///< number of quick bins (one per BS)
+#define QUICK_FRAG_SHIFT   2                           ///< consolidate if quick bins hold > heap/4
+
+// Regions
+#define REGION_CHUNK       (1 << 16)                   ///< default chunk size of a region
+#define REGION_ALIGN       16                          ///< alignment of region allocations
+#define REGION_BATCH       64                          ///< chunks released per mm_free_batch()
+
+/// @brief slab run descriptor, stored at the beginning of the payload of a run block
+struct SlabRun {
+  struct SlabRun *next;                                ///< next run of same class with free slots
+  struct SlabRun *prev;                                ///< previous run of same class with free slots
+  unsigned int cls;                                    ///< size class
+  unsigned int stride;                                 ///< slot size (tag + object) in bytes
+  unsigned int nslots;                                 ///< number of slots
+  unsigned int nfree;                                  ///< number of free slots
+  unsigned long map[SLAB_MAP_WORDS];                   ///< free slot bitmap (1: free)
+};
 
-// Freelist
-static FreelistPolicy freelist_policy  = 0;            ///< free list management policy
+/// @brief arena: a heap with its own free lists. In single-threaded mode, arenas[0] manages the
+///        entire data segment. In thread-safe mode, each arena manages a slice of it.
+struct Arena {
+  void *ds_heap_start;                                 ///< physical start of data segment (slice)
+  void *ds_heap_brk;                                   ///< physical end of data segment (slice)
+  void *ds_heap_limit;                                 ///< end of slice (NULL: use ds_sbrk())
+  char *link_base;                                     ///< base address of 32-bit free list links
+  int handle;                                          ///< created by mm_heap_create()
+  void *heap_start;                                    ///< logical start of heap
+  void *heap_end;                                      ///< logical end of heap
+
+  // Block layout and front-ends, fixed when the arena is initialized
+  int footers;                                         ///< footers on allocated blocks (yes: 1, no: 0)
+  int slab;                                            ///< slab front-end (on: 1, off: 0)
+  int quick;                                           ///< quick bins (on: 1, off: 0)
+
+  // Freelist
+  FreelistPolicy freelist_policy;                      ///< free list management policy
+  void *(*get_free_block)(size_t);                     ///< get free block for selected allocation policy
+  void (*add_free_block)(void*);                       ///< add free block to free list of selected policy
+  void (*remove_free_block)(void*);                    ///< remove free block from free list of selected policy
+  void *free_head;                                     ///< first free block (explicit/address-ordered list)
+  void *rover;                                         ///< next fit roving pointer (address-ordered list)
+  void *ao_hint;                                       ///< insertion hint (address-ordered list)
+  unsigned long tlsf_fl_bitmap;                        ///< non-empty first-level classes (TLSF)
+  unsigned int  tlsf_sl_bitmap[TLSF_FL_COUNT];         ///< non-empty second-level classes (TLSF)
+  void *tlsf_heads[TLSF_FL_COUNT][TLSF_SL_COUNT];      ///< heads of segregated free lists (TLSF)
+  void *tree_root;                                     ///< root of free block tree (splay tree)
+  unsigned long *gran_map;                             ///< free granule bitmap (bitmap)
+  unsigned long *gran_sum;                             ///< non-zero words of gran_map (bitmap)
+  size_t gran_bytes;                                   ///< size of the bitmap mapping (bitmap)
+  size_t gran_low[64];                                 ///< no free block of >= 2^c granules starts
+                                                       ///< below word gran_low[c] (bitmap)
+  size_t tree_steps;                                   ///< nodes visited by tree_splay()
+
+  // Slab front-end
+  struct SlabRun *slab_partial[SLAB_CLASSES];          ///< runs with free slots, per class
+
+  // Heap growth/trim controller
+  size_t grow_step;                                    ///< current heap extension step
+  unsigned long clock;                                 ///< number of block allocations/frees
+  unsigned long last_grow;                             ///< clock at last heap extension
+
+  // Realloc history
+  void *realloc_hist[REALLOC_HIST];                    ///< payloads recently returned by realloc()
+  int realloc_next;                                    ///< next history entry to replace
+
+  // Quick bins
+  void *quick_bins[QUICK_BINS];                        ///< LIFO lists of freed blocks, per block size
+  size_t quick_bytes;                                  ///< total size of blocks in quick bins
+
+  // Statistics
+  struct mm_stats stats;                               ///< counters, maintained incrementally
+  size_t heap_peak;                                    ///< peak size of the arena's data segment
+
+  // Sampling verifier
+  unsigned long verify_ops;                            ///< operations since mm_init()
+  void *verify_freed;                                  ///< block touched by the current free
+
+  pthread_mutex_t lock;                                ///< arena lock (thread-safe mode)
+  void *remote_free;                                   ///< blocks freed by other threads (lock-free)
+};
 
-// Free chunk for explicit free list
-struct FreeChunk {
-    size_t size;                                   ///< size of free chunk (header)
-    void* next;                                    ///< pointer to next free chunk
-    void* prev;                                    ///< pointer to previous free chunk
-    void* dummy;                                   ///< dummy pointer to align to 32 bytes
+// Arenas
+#define MAX_ARENAS         64                          ///< maximum number of arenas
+static struct Arena arenas[MAX_ARENAS];                ///< arenas; arenas[0] in single-threaded mode
+static __thread struct Arena *arena = &arenas[0];      ///< arena operated on by the current thread
+static int  mm_narenas     = 0;                        ///< number of arenas (0: single-threaded mode)
+static size_t arena_slice  = 0;                        ///< size of data segment slice per arena
+static int  arena_next     = 0;                        ///< next home arena to assign (round-robin)
+
+// Thread cache
+#define TCACHE_MAX         512                         ///< largest block size kept in thread cache
+#define TCACHE_BINS        (TCACHE_MAX / MM_GRANULE)   ///< number of thread cache bins (one per BS)
+#define TCACHE_FILL        16                          ///< maximum number of blocks per bin
+
+/// @brief per-thread cache of recently freed small blocks (thread-safe mode)
+struct TCache {
+  void *bin[TCACHE_BINS];                              ///< cached blocks (header), linked via payload
+  unsigned int count[TCACHE_BINS];                     ///< number of blocks per bin
+  int home;                                            ///< index of home arena
+  unsigned long generation;                            ///< heap generation the cache belongs to
 };
-static struct FreeChunk first;                     ///< first free chunk
-static struct FreeChunk last;                      ///< last free chunk
+static __thread struct TCache tcache;                  ///< thread cache of the current thread
+static unsigned long mm_generation = 0;                ///< incremented by mm_init(); invalidates caches
+static pthread_key_t tcache_key;                       ///< key to flush the thread cache on thread exit
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT; ///< creates tcache_key once
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;   ///< registers the fork handlers once
 
 //
 // TODO: add more global variables as needed
@@ -116,18 +565,38 @@ static struct FreeChunk last;                      ///< last free chunk
 /// @name Macro definitions
 /// @{
 #define MAX(a, b)          ((a) > (b) ? (a) : (b))     ///< MAX function
+#define MIN(a, b)          ((a) < (b) ? (a) : (b))     ///< MIN function
 
-#define TYPE               unsigned long               ///< word type of heap
+#if MM_TAG_SIZE == 8
+  #define TYPE             unsigned long               ///< word type of heap
+  #define HDR_OFS          0                           ///< offset of block headers from BS grid
+  #define PAYLOAD_ALIGN    8                           ///< alignment of all payloads
+#else
+  #define TYPE             uint32_t                    ///< word type of heap
+  #define HDR_OFS          (BS - TYPE_SIZE)            ///< offset of block headers from BS grid
+  #define PAYLOAD_ALIGN    BS                          ///< alignment of all payloads
+#endif
 #define TYPE_SIZE          sizeof(TYPE)                ///< size of word type
 
 #define ALLOC              1                           ///< block allocated flag
 #define FREE               0                           ///< block free flag
+#define PREV_ALLOC         2                           ///< previous block allocated flag
+#define SLAB               4                           ///< block is a slab run (header flag)
+#define TAG                4                           ///< word preceding payload is a tag
+#define TAG_SLAB           1                           ///< tag kind: slot in slab run
+#define TAG_MMAP           2                           ///< tag kind: large object in own mapping
+#define TAG_ALIGN          3                           ///< tag kind: aligned payload inside block
+#define MMAP_HDR           16                          ///< mapping size + tag
 #define STATUS_MASK        ((TYPE)(0x7))               ///< mask to retrieve flags from header/footer
 #define SIZE_MASK          (~STATUS_MASK)              ///< mask to retrieve size from header/footer
 
-#define BS                 32                          ///< minimal block size. Must be a power of 2
+#define BS                 MM_GRANULE                  ///< minimal block size. Must be a power of 2
 #define BS_MASK            (~(BS-1))                   ///< alignment mask
 
+#define GRID_DOWN(p)       ((void*)((((uintptr_t)(p) - HDR_OFS) & BS_MASK) + HDR_OFS)) ///< header at/below p
+#define GRID_UP(p)         GRID_DOWN((char *)(p) + BS - 1)                         ///< header at/above p
+#define ON_GRID(p)         ((((uintptr_t)(p) - HDR_OFS) & (BS-1)) == 0)            ///< p is a header position
+
 #define WORD(p)            ((TYPE)(p))                 ///< convert pointer to TYPE
 #define PTR(w)             ((void*)(w))                ///< convert TYPE to void*
 
@@ -139,23 +608,66 @@ static struct FreeChunk last;                      ///< last free chunk
 
 #define PACK(size,status)  ((size) | (status))         ///< pack size & status into boundary tag
 #define SIZE(v)            (v & SIZE_MASK)             ///< extract size from boundary tag
-#define STATUS(v)          (v & STATUS_MASK)           ///< extract status from boundary tag
+#define STATUS(v)          (v & ALLOC)                 ///< extract status from boundary tag
 
 #define PUT(p, v)          (*(TYPE*)(p) = (TYPE)(v))   ///< write word v to *p
 #define GET(p)             (*(TYPE*)(p))               ///< read word at *p
-#define GET_SIZE(p)        (SIZE(GET(p)))              ///< extract size from header/footer
+#define GET_SIZE(p)        ((size_t)SIZE(GET(p)))      ///< extract size from header/footer
 #define GET_STATUS(p)      (STATUS(GET(p)))            ///< extract status from header/footer
+#define GET_PREV_ALLOC(p)  (GET(p) & PREV_ALLOC)       ///< extract prev-alloc flag from header
+
+#define ALLOC_OVERHEAD     (arena->footers ? 2*TYPE_SIZE : TYPE_SIZE) ///< tag overhead of allocated block
+#define REQ_SIZE(size)     (((size) + ALLOC_OVERHEAD + BS - 1) & BS_MASK) ///< block size for payload
+
+#define PACK_TAG(ofs,kind) (((TYPE)(ofs) << 3) | TAG | (kind)) ///< pack offset & kind into tag
+#define TAG_OFS(v)         ((v) >> 3)                  ///< offset from tag to block header
+#define TAG_KIND(v)        ((v) & 3)                   ///< extract kind from tag
+#define IS_MMAPPED(ptr)    ((GET(PREV_PTR(ptr)) & (TAG|3)) == (TAG|TAG_MMAP)) ///< ptr in own mapping
+#define IS_ALIGNED(ptr)    ((GET(PREV_PTR(ptr)) & (TAG|3)) == (TAG|TAG_ALIGN)) ///< ptr by mm_memalign()
+#define MMAP_SIZE(m)       (*(size_t *)(m))            ///< size of mapping starting at m
+
+#define SLAB_CLASS(size)   (((size) + TYPE_SIZE - 1) / SLAB_ALIGN) ///< slab class of request
+#define SLAB_FIRST         ((TYPE_SIZE + sizeof(struct SlabRun) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN-1))
+                                                       ///< offset of first slot from run header
 
 #define NEXT_BLKP(p)       ((char *)(p)+GET_SIZE(p))              ///< get pointer to next block
 #define PREV_BLKP(p)       ((char *)(p)-GET_SIZE(PREV_PTR(p)))    ///< get pointer to previous block
-#define NEXT_LIST_GET(p)   (*(void **)(NEXT_PTR(p)))               ///< get pointer to next free block
-#define PREV_LIST_GET(p)   (*(void **)(NEXT_NEXT_PTR(p)))     ///< get pointer to previous free block
+#if MM_TAG_SIZE == 8
+  #define LINK_GET(p)      (*(void **)(p))                    ///< read link at p
+  #define LINK_PUT(p, v)   (*(void **)(p) = (v))              ///< write link v to p
+#else
+  #define LINK_GET(p)      link_decode(GET(p))                ///< read link at p
+  #define LINK_PUT(p, v)   PUT(p, link_encode(v))             ///< write link v to p
+#endif
+
+#define NEXT_LIST_GET(p)   LINK_GET(NEXT_PTR(p))              ///< get pointer to next free block
+#define PREV_LIST_GET(p)   LINK_GET(NEXT_NEXT_PTR(p))         ///< get pointer to previous free block
+#define NEXT_LIST_SET(p,v) LINK_PUT(NEXT_PTR(p), v)           ///< set pointer to next free block
+#define PREV_LIST_SET(p,v) LINK_PUT(NEXT_NEXT_PTR(p), v)      ///< set pointer to previous free block
+#define TREE_LEFT(p)       LINK_GET(NEXT_PTR(p))              ///< left child of free block in tree
+#define TREE_RIGHT(p)      LINK_GET(NEXT_NEXT_PTR(p))         ///< right child of free block in tree
+#define TREE_SET_LEFT(p,v) LINK_PUT(NEXT_PTR(p), v)           ///< set left child of free block
+#define TREE_SET_RIGHT(p,v) LINK_PUT(NEXT_NEXT_PTR(p), v)     ///< set right child of free block
 
 //
 // TODO: add more macros as needed
 //
 /// @}
 
+#if MM_TAG_SIZE == 4
+/// @brief decode 32-bit link @a w
+static inline void* link_decode(TYPE w)
+{
+  return w ? arena->link_base + w : NULL;
+}
+
+/// @brief encode @a p as a 32-bit link
+static inline TYPE link_encode(void *p)
+{
+  return p ? (TYPE)((char *)p - arena->link_base) : 0;
+}
+#endif
+
 
 /// @name Logging facilities
 /// @{
@@ -220,25 +732,180 @@ static void mm_panic(const char *func, ...)
 
 static void* bf_get_free_block_implicit(size_t size);
 static void* bf_get_free_block_explicit(size_t size);
+static void* ff_get_free_block_ordered(size_t size);
+static void* nf_get_free_block_ordered(size_t size);
+static void* gf_get_free_block_ordered(size_t size);
+static void* gf_get_free_block_tlsf(size_t size);
+static void* bf_get_free_block_tree(size_t size);
+static void* ff_get_free_block_bitmap(size_t size);
+static void gran_update(void *bp, size_t size, int is_free);
+static void gran_lower(void *bp, size_t size);
 static void* coalesce(void* bp, int shrink);
-static void place(void* bp, size_t asize);
+static void* place(void* bp, size_t lead, size_t asize);
 static void *extend_heap(size_t words);
-static void add_free_block(void* bp);
-static void remove_free_block(void* bp);
+static void mark_alloc(void *bp, size_t size, TYPE prev_alloc);
+static void mark_free(void *bp, size_t size, TYPE prev_alloc);
+static void* alloc_block(size_t req_size);
+static void free_block(void *bp);
+static void* slab_malloc(size_t size);
+static struct Arena* arena_of(void *ptr);
+static void arena_lock(struct Arena *a);
+static void fork_init(void);
+static void slab_free(void *ptr);
+static void quick_consolidate(void);
+static size_t payload_size(void *ptr);
+static void add_free_block_implicit(void* bp);
+static void remove_free_block_implicit(void* bp);
+static void add_free_block_explicit(void* bp);
+static void remove_free_block_explicit(void* bp);
+static void add_free_block_ordered(void* bp);
+static void remove_free_block_ordered(void* bp);
+static void add_free_block_tlsf(void* bp);
+static void remove_free_block_tlsf(void* bp);
+static void add_free_block_tree(void* bp);
+static void remove_free_block_tree(void* bp);
+
+/// @brief grow or shrink the data segment of the current arena by @a increment bytes. Operates
+///        like ds_sbrk() in single-threaded mode and within the arena's slice otherwise.
+/// @param increment offset by which to increase/decrease current brk.
+/// @retval old brk on success.
+/// @retval (void*)-1 on error. errno is set to ENOMEM
+static void *arena_sbrk(intptr_t increment)
+{
+  char *old_brk = arena->ds_heap_brk;
+  char *brk = old_brk + increment;
 
-void mm_init(FreelistPolicy fp)
+  if(increment == 0) return old_brk;
+
+  if(arena->ds_heap_limit == NULL) {
+    if(ds_sbrk(increment) == (void*)-1) return (void*)-1;
+  } else if((brk < (char*)arena->ds_heap_start) || (brk > (char*)arena->ds_heap_limit)) {
+    errno = ENOMEM;
+    return (void*)-1;
+  }
+
+  arena->ds_heap_brk = brk;
+  arena->stats.sbrk_calls++;
+  arena->heap_peak = MAX(arena->heap_peak, (size_t)(brk - (char*)arena->ds_heap_start));
+
+  return old_brk;
+}
+
+/// @brief histogram bin of free block size @a size
+/// @param size block size
+static int stats_bin(size_t size)
 {
-  LOG(1, "mm_init()");
+  int bin = (63 - __builtin_clzl(size)) - __builtin_ctzl(BS);
+  return bin < MM_STATS_BINS ? bin : MM_STATS_BINS-1;
+}
+
+/// @brief add free block @a bp to the free list(s) of the selected policy and update statistics
+/// @param bp pointer to header of free block
+static void free_list_add(void *bp)
+{
+  size_t size = GET_SIZE(bp);
+  arena->stats.free_bytes += size;
+  arena->stats.free_blocks++;
+  arena->stats.free_hist[stats_bin(size)]++;
+
+  arena->add_free_block(bp);
+}
+
+/// @brief remove free block @a bp from the free list(s) of the selected policy and update
+///        statistics
+/// @param bp pointer to header of free block
+static void free_list_remove(void *bp)
+{
+  size_t size = GET_SIZE(bp);
+  arena->stats.free_bytes -= size;
+  arena->stats.free_blocks--;
+  arena->stats.free_hist[stats_bin(size)]--;
+
+  arena->remove_free_block(bp);
+}
+
+/// @brief find a free block of at least @a size bytes with the selected policy and update
+///        statistics
+/// @param size block size
+/// @retval void* pointer to header of free block
+/// @retval NULL if no suitable block exists
+static void* free_list_get(size_t size)
+{
+  arena->stats.searches++;
+  return arena->get_free_block(size);
+}
+
+/// @brief initialize heap and free lists of the current arena. The arena's data segment
+///        (ds_heap_start, ds_heap_brk, ds_heap_limit) must be set up by the caller.
+/// @param fp free list policy
+static void arena_init(FreelistPolicy fp)
+{
+  // reset statistics
+  memset(&arena->stats, 0, sizeof(arena->stats));
+  arena->heap_peak = 0;
+
+  // the block layout must not change while the arena has blocks; later calls to mm_setfooter(),
+  // mm_setslab(), and mm_setquickbins() only affect arenas initialized afterwards
+  arena->footers = mm_footers;
+  arena->slab = mm_slab;
+  arena->quick = mm_quick;
 
   // set free list policy
-  freelist_policy = fp;
-  switch (freelist_policy) {
+  arena->freelist_policy = fp;
+  switch (arena->freelist_policy) {
     case fp_Implicit:
-      get_free_block = bf_get_free_block_implicit;
+      arena->get_free_block = bf_get_free_block_implicit;
+      arena->add_free_block = add_free_block_implicit;
+      arena->remove_free_block = remove_free_block_implicit;
       break;
       
     case fp_Explicit:
-      get_free_block = bf_get_free_block_explicit;
+      arena->get_free_block = bf_get_free_block_explicit;
+      arena->add_free_block = add_free_block_explicit;
+      arena->remove_free_block = remove_free_block_explicit;
+      break;
+
+    case fp_FirstFit:
+      arena->get_free_block = ff_get_free_block_ordered;
+      arena->add_free_block = add_free_block_ordered;
+      arena->remove_free_block = remove_free_block_ordered;
+      break;
+
+    case fp_NextFit:
+      arena->get_free_block = nf_get_free_block_ordered;
+      arena->add_free_block = add_free_block_ordered;
+      arena->remove_free_block = remove_free_block_ordered;
+      break;
+
+    case fp_BestFit:
+      arena->get_free_block = bf_get_free_block_explicit;
+      arena->add_free_block = add_free_block_ordered;
+      arena->remove_free_block = remove_free_block_ordered;
+      break;
+
+    case fp_GoodFit:
+      arena->get_free_block = gf_get_free_block_ordered;
+      arena->add_free_block = add_free_block_ordered;
+      arena->remove_free_block = remove_free_block_ordered;
+      break;
+
+    case fp_TLSF:
+      arena->get_free_block = gf_get_free_block_tlsf;
+      arena->add_free_block = add_free_block_tlsf;
+      arena->remove_free_block = remove_free_block_tlsf;
+      break;
+
+    case fp_SplayTree:
+      arena->get_free_block = bf_get_free_block_tree;
+      arena->add_free_block = add_free_block_tree;
+      arena->remove_free_block = remove_free_block_tree;
+      break;
+
+    case fp_Bitmap:
+      // free blocks are found in the bitmap, which place() and coalesce() maintain
+      arena->get_free_block = ff_get_free_block_bitmap;
+      arena->add_free_block = add_free_block_implicit;
+      arena->remove_free_block = remove_free_block_implicit;
       break;
     
     default:
@@ -246,8 +913,104 @@ void mm_init(FreelistPolicy fp)
       break;
   }
 
+  // initialize heap with CHUNK SIZE, update ds_heap_brk
+  if(arena_sbrk(mm_grow_min) == (void*)-1) PANIC("ds_sbrk() failed in mm_init()");
+  arena->ds_heap_brk = arena_sbrk(0);
+
+  // initialize heap_start, heap_end. On the BS grid
+  arena->heap_start = GRID_UP((char *)arena->ds_heap_start + TYPE_SIZE); // initial sentinel half-block considered
+  arena->heap_end = GRID_DOWN((char *)arena->ds_heap_brk - TYPE_SIZE); // end sentinel half-block considered
+
+  // initialize sentinels, free chunk
+  PUT(PREV_PTR(arena->heap_start), PACK(0, ALLOC));
+  PUT(arena->heap_end, PACK(0, ALLOC));
+  size_t size = (char *)arena->heap_end - (char *)arena->heap_start;
+  mark_free(arena->heap_start, size, PREV_ALLOC);
+
+  // initialize free list(s) and add the initial free chunk
+  arena->free_head = NULL;
+  arena->rover = NULL;
+  arena->ao_hint = NULL;
+
+  arena->tlsf_fl_bitmap = 0;
+  memset(arena->tlsf_sl_bitmap, 0, sizeof(arena->tlsf_sl_bitmap));
+  memset(arena->tlsf_heads, 0, sizeof(arena->tlsf_heads));
+
+  arena->tree_root = NULL;
+
+  // map the granule bitmap for the largest possible heap of the arena. Pages are only touched as
+  // the heap grows
+  if(arena->gran_map != NULL) munmap(arena->gran_map, arena->gran_bytes);
+  arena->gran_map = arena->gran_sum = NULL;
+  memset(arena->gran_low, 0, sizeof(arena->gran_low));
+  if(fp == fp_Bitmap) {
+    void *ds_heap_end = arena->ds_heap_limit;
+    if(ds_heap_end == NULL) {
+      void *start, *brk;
+      ds_heap_stat(&start, &brk, &ds_heap_end);
+    }
+    size_t words = (((char*)ds_heap_end - (char*)arena->heap_start) >> MM_GRANULE_LOG2) / 64 + 1;
+    size_t sum_words = words / 64 + 1;
+    arena->gran_bytes = (words + sum_words) * sizeof(unsigned long);
+    arena->gran_map = mmap(NULL, arena->gran_bytes, PROT_READ|PROT_WRITE,
+                           MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if(arena->gran_map == MAP_FAILED) PANIC("Cannot map granule bitmap.");
+    arena->gran_sum = arena->gran_map + words;
+    gran_update(arena->heap_start, size, 1);
+  }
+
+  memset(arena->slab_partial, 0, sizeof(arena->slab_partial));
+  free_list_add(arena->heap_start);
+
+  arena->grow_step = mm_grow_min;
+  arena->clock = 0;
+  arena->last_grow = 0;
+
+  memset(arena->realloc_hist, 0, sizeof(arena->realloc_hist));
+  arena->realloc_next = 0;
+
+  memset(arena->quick_bins, 0, sizeof(arena->quick_bins));
+  arena->quick_bytes = 0;
+
+  arena->verify_ops = 0;
+  arena->verify_freed = NULL;
+
+  pthread_mutex_init(&arena->lock, NULL);
+  arena->remote_free = NULL;
+}
+
+/// @brief flush the thread cache of the calling thread: return all cached blocks to their arenas
+/// @param arg unused (pthread key destructor)
+static void tcache_flush(void *arg)
+{
+  if(tcache.generation == mm_generation) {
+    for(int i = 0; i < TCACHE_BINS; i++) {
+      while(tcache.bin[i] != NULL) {
+        void *bp = tcache.bin[i];
+        tcache.bin[i] = NEXT_LIST_GET(bp);
+
+        arena_lock(arena_of(bp));
+        free_block(bp);
+        pthread_mutex_unlock(&arena->lock);
+      }
+    }
+  }
+  memset(&tcache, 0, sizeof(tcache));
+}
+
+/// @brief create the key used to flush thread caches on thread exit
+static void tcache_key_init(void)
+{
+  if(pthread_key_create(&tcache_key, tcache_flush) != 0) PANIC("Cannot create thread cache key.");
+}
+
+void mm_init(FreelistPolicy fp)
+{
+  LOG(1, "mm_init()");
+
   // retrieve heap status and perform a few initial sanity checks
-  ds_heap_stat(&ds_heap_start, &ds_heap_brk, NULL);
+  void *ds_heap_start, *ds_heap_brk, *ds_heap_end;
+  ds_heap_stat(&ds_heap_start, &ds_heap_brk, &ds_heap_end);
   PAGESIZE = ds_getpagesize();
 
   LOG(2, "  ds_heap_start:          %p\n"
@@ -258,31 +1021,37 @@ void mm_init(FreelistPolicy fp)
   if (ds_heap_start == NULL) PANIC("Data segment not initialized.");
   if (ds_heap_start != ds_heap_brk) PANIC("Heap not clean.");
   if (PAGESIZE == 0) PANIC("Reported pagesize == 0.");
+#if MM_TAG_SIZE == 4
+  if ((size_t)((char*)ds_heap_end - (char*)ds_heap_start) > UINT32_MAX) PANIC("Data segment too large for 32-bit tags.");
+#endif
 
-  // initialize heap with CHUNK SIZE, update ds_heap_brk
-  if(ds_sbrk(CHUNKSIZE) == (void*)-1) PANIC("ds_sbrk() failed in mm_init()");
-  ds_heap_brk = ds_sbrk(0);
-
-  // initialize heap_start, heap_end. 32 bytes aligned
-  // int 
-  heap_start = (void *)((TYPE)((char *)ds_heap_start + TYPE_SIZE + BS - 1) & BS_MASK); // initial sentinel half-block considered
-  heap_end = (void *)((TYPE)((char *)ds_heap_brk - TYPE_SIZE) & BS_MASK); // end sentinel half-block considered
+  // invalidate all thread caches
+  mm_generation++;
+
+  if(mm_narenas == 0) {
+    // single-threaded mode: arenas[0] manages the entire data segment
+    arena = &arenas[0];
+    arena->ds_heap_start = arena->ds_heap_brk = ds_heap_start;
+    arena->ds_heap_limit = NULL;
+    arena->link_base = ds_heap_start;
+    arena_init(fp);
+  } else {
+    // thread-safe mode: carve one page-aligned slice per arena out of the data segment
+    arena_slice = (((char*)ds_heap_end - (char*)ds_heap_start - PAGESIZE) / mm_narenas) & ~((size_t)PAGESIZE-1);
+    if(arena_slice < mm_grow_min) PANIC("Data segment too small for %d arenas.", mm_narenas);
+    if(ds_sbrk(arena_slice * mm_narenas) == (void*)-1) PANIC("ds_sbrk() failed in mm_init()");
+
+    for(int i = 0; i < mm_narenas; i++) {
+      arena = &arenas[i];
+      arena->ds_heap_start = arena->ds_heap_brk = (char*)ds_heap_start + i * arena_slice;
+      arena->ds_heap_limit = (char*)arena->ds_heap_start + arena_slice;
+      arena->link_base = ds_heap_start;   // shared by all arenas: thread caches mix their blocks
+      arena_init(fp);
+    }
+    arena = &arenas[0];
 
-  // initialize sentinels, free chunk
-  PUT(PREV_PTR(heap_start), PACK(0, 1));
-  PUT(heap_end, PACK(0, 1));
-  size_t size = (char *)heap_end - (char *)heap_start;
-  PUT(heap_start, PACK(size,0));
-  PUT(PREV_PTR(heap_end), PACK(size,0));
-
-  // initialize free list
-  if(freelist_policy == fp_Explicit) {
-    first.next = heap_start;
-    first.prev = NULL;
-    last.next = NULL;
-    last.prev = heap_start;
-    PUT(NEXT_PTR(heap_start), &last);
-    PUT(NEXT_NEXT_PTR(heap_start), &first);
+    pthread_once(&tcache_once, tcache_key_init);
+    pthread_once(&fork_once, fork_init);
   }
 
   // heap is now initialized
@@ -296,9 +1065,9 @@ void mm_init(FreelistPolicy fp)
 static void* bf_get_free_block_implicit(size_t size)
 {
   LOG(1, "bf_get_free_block_implicit(0x%lx (%lu))", size, size);
-  assert(mm_initialized);
+  assert(arena->heap_start != NULL);
 
-  char* block = heap_start;
+  char* block = arena->heap_start;
   char* best_fit_block = NULL;
   size_t best_fit_size = -1;
 
@@ -308,6 +1077,7 @@ static void* bf_get_free_block_implicit(size_t size)
 
     // met the end sentinel half-block
     if(!b_size) break;
+    arena->stats.search_len++;
 
     if(b_alloc == 0) { // free block found
       if(b_size == size) { // if it perfectly fits, return right away
@@ -332,15 +1102,16 @@ static void* bf_get_free_block_implicit(size_t size)
 static void* bf_get_free_block_explicit(size_t size)
 {
   LOG(1, "bf_get_free_block_explicit(0x%lx (%lu))", size, size);
-  assert(mm_initialized);
+  assert(arena->heap_start != NULL);
   
-  char* block = NEXT_LIST_GET(&first);
+  char* block = arena->free_head;
   char* best_fit_block = NULL;
   size_t best_fit_size = -1;
 
   while(block != NULL){
     size_t b_size = GET_SIZE(block);
     int b_alloc = GET_STATUS(block);
+    arena->stats.search_len++;
 
     if(b_alloc == 0) { // free block found
       if(b_size == size) { // if it perfectly fits, return right away
@@ -356,19 +1127,98 @@ static void* bf_get_free_block_explicit(size_t size)
   return best_fit_block;
 }
 
+/// @brief address-ordered list: find and return the first free block of at least @a size bytes
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* ff_get_free_block_ordered(size_t size)
+{
+  LOG(1, "ff_get_free_block_ordered(0x%lx (%lu))", size, size);
+  assert(arena->heap_start != NULL);
+
+  for(char *block = arena->free_head; block != NULL; block = NEXT_LIST_GET(block)) {
+    arena->stats.search_len++;
+    if(GET_SIZE(block) >= size) return block;
+  }
+
+  return NULL;
+}
+
+/// @brief address-ordered list: find and return the first free block of at least @a size bytes
+///        at or after the roving pointer, wrapping around at the end of the list (next fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* nf_get_free_block_ordered(size_t size)
+{
+  LOG(1, "nf_get_free_block_ordered(0x%lx (%lu))", size, size);
+  assert(arena->heap_start != NULL);
+
+  char *start = arena->rover != NULL ? arena->rover : arena->free_head;
+  char *block = start;
+
+  while(block != NULL) {
+    arena->stats.search_len++;
+    if(GET_SIZE(block) >= size) {
+      arena->rover = block;
+      return block;
+    }
+
+    block = NEXT_LIST_GET(block);
+    if(block == NULL) block = arena->free_head;   // wrap around
+    if(block == start) break;
+  }
+
+  return NULL;
+}
+
+/// @brief address-ordered list: find and return the first free block of at least @a size bytes
+///        that wastes at most mm_goodfit_tol percent of @a size. If there is none, return the
+///        best fit.
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* gf_get_free_block_ordered(size_t size)
+{
+  LOG(1, "gf_get_free_block_ordered(0x%lx (%lu))", size, size);
+  assert(arena->heap_start != NULL);
+
+  char *best_fit_block = NULL;
+  size_t best_fit_size = -1;
+  size_t tolerance = size * mm_goodfit_tol / 100;
+
+  for(char *block = arena->free_head; block != NULL; block = NEXT_LIST_GET(block)) {
+    size_t b_size = GET_SIZE(block);
+    arena->stats.search_len++;
+
+    if(b_size >= size) {
+      if(b_size - size <= tolerance) return block;   // good enough
+      if(b_size < best_fit_size) {
+        best_fit_block = block;
+        best_fit_size = b_size;
+      }
+    }
+  }
+
+  return best_fit_block;
+}
+
 // free blocks merge 시 free list 내 위치 반영해야 하는지?
 static void *coalesce(void *bp, int shrink) {
   LOG(1, "coalesce(0x%p)", bp);
-  assert(mm_initialized);
+  assert(arena->heap_start != NULL);
 
   if(GET_STATUS(bp) == 1) {
     printf("Allocated block passed to coalesce()");
     return NULL;
   }
   
-  // PREV_BLKP(bp)의 경우 SIZE=0인 initial sentinel half-block에서 에러 발생, PREV_PTR(bp)로 체크
-  int prev_alloc = GET_STATUS(PREV_PTR(bp));
-  void *prev_bp = PREV_BLKP(bp);
+  // mark the granules of the freed block in the bitmap; its free neighbors are marked already
+  gran_update(bp, GET_SIZE(bp), 1);
+
+  // the predecessor's footer only exists if it is free; check the prev-alloc bit instead
+  int prev_alloc = GET_PREV_ALLOC(bp);
+  void *prev_bp = prev_alloc ? NULL : PREV_BLKP(bp);
   int next_alloc = GET_STATUS(NEXT_BLKP(bp));
   void *next_bp = NEXT_BLKP(bp);
 
@@ -378,52 +1228,56 @@ static void *coalesce(void *bp, int shrink) {
 
   if(prev_alloc && !next_alloc) { // case 2 : prev allocated, next free
     // remove next block from free list
-    if(freelist_policy == fp_Explicit) remove_free_block(next_bp);
+    free_list_remove(next_bp);
+    arena->stats.coalesces++;
 
     size += GET_SIZE(next_bp);
-    PUT(bp, PACK(size, 0));
-    PUT(HDR2FTR(bp), PACK(size, 0));
-    // PUT(next_bp, 0); PUT(PREV_PTR(next_bp), 0);
+    mark_free(bp, size, PREV_ALLOC);
   } else if(!prev_alloc && next_alloc) { // case 3 : prev free, next allocated
     // remove prev_block from free list
-    if(freelist_policy == fp_Explicit) remove_free_block(prev_bp);
+    free_list_remove(prev_bp);
+    arena->stats.coalesces++;
 
     size += GET_SIZE(prev_bp);
-    PUT(prev_bp, PACK(size, 0));
-    PUT(HDR2FTR(prev_bp), PACK(size, 0));
-    // PUT(bp, 0); PUT(PREV_PTR(bp), 0);
+    mark_free(prev_bp, size, PREV_ALLOC);
     result = prev_bp;
   } else if(!prev_alloc && !next_alloc) { // case 4 : prev free, next free
     // remove prev_block, next_block from free list
-    if(freelist_policy == fp_Explicit) {
-      remove_free_block(prev_bp);
-      remove_free_block(next_bp);
-    }
+    free_list_remove(prev_bp);
+    free_list_remove(next_bp);
+    arena->stats.coalesces += 2;
 
     size += (GET_SIZE(prev_bp) + GET_SIZE(next_bp));
-    PUT(prev_bp, PACK(size, 0));
-    PUT(HDR2FTR(prev_bp), PACK(size, 0));
-    // PUT(next_bp, 0); PUT(PREV_PTR(next_bp), 0); PUT(bp, 0); PUT(PREV_PTR(bp), 0);
+    mark_free(prev_bp, size, PREV_ALLOC);
     result = prev_bp;
   }
   // case 1 : prev allocated, next allocated => do nothing
 
-  // if coalesce() is called from mm_free() && coalesced block is at the end of heap && size >= BS + SHRINKTHLD
-  if(shrink && NEXT_BLKP(result) == heap_end && size >= BS + SHRINKTHLD) {
-    // shrink heap
-    if(ds_sbrk(-1 * (int)SHRINKTHLD) != (void*)-1) {
-      ds_heap_brk = ds_sbrk(0);
-      heap_end = (void *)((TYPE)((char *)ds_heap_brk - TYPE_SIZE) & BS_MASK);
-
-      size = (char *)heap_end - result;
-      PUT(heap_end, PACK(0, 1));
-      PUT(result, PACK(size, 0));
-      PUT(PREV_PTR(heap_end), PACK(size, 0));
+  // if coalesce() is called from mm_free() && coalesced block is at the end of heap && the
+  // block is larger than the trim threshold && the heap was not extended recently
+  if(shrink && NEXT_BLKP(result) == arena->heap_end && size > mm_trim_thld &&
+     arena->clock - arena->last_grow > mm_trim_delay) {
+    // shrink heap, keep mm_trim_pad bytes at the tail
+    intptr_t trim = (size - MAX(mm_trim_pad, BS)) & ~((size_t)PAGESIZE-1);
+    if(trim > 0 && arena_sbrk(-trim) != (void*)-1) {
+      char *old_end = arena->heap_end;
+      arena->ds_heap_brk = arena_sbrk(0);
+      arena->grow_step = mm_grow_min;
+      arena->heap_end = GRID_DOWN((char *)arena->ds_heap_brk - TYPE_SIZE);
+      gran_update(arena->heap_end, old_end - (char*)arena->heap_end, 0);
+
+      size = (char *)arena->heap_end - result;
+      PUT(arena->heap_end, PACK(0, ALLOC));
+      mark_free(result, size, PREV_ALLOC);
     }
   }
 
+  // the merged block may start lower and be larger than the freed one
+  if(arena->freelist_policy == fp_Bitmap) gran_lower(result, size);
+
   // add coalesced block to free list
-  if(freelist_policy == fp_Explicit) add_free_block(result);
+  free_list_add(result);
+  arena->verify_freed = result;
   
   return result;
 }
@@ -432,280 +1286,2543 @@ static void *coalesce(void *bp, int shrink) {
 static void *extend_heap(size_t size)
 {
   LOG(1, "extend_heap(%lu words)", words);
-  assert(mm_initialized);
+  assert(arena->heap_start != NULL);
 
-  char *bp = heap_end;
+  char *bp = arena->heap_end;
+  TYPE prev_alloc = GET_PREV_ALLOC(bp);
 
   // increase heap size
-  if((long)ds_sbrk(size) == -1) return NULL;
-  ds_heap_brk = ds_sbrk(0);
+  if((long)arena_sbrk(size) == -1) return NULL;
+  arena->ds_heap_brk = arena_sbrk(0);
 
-  // update heap end. get free block size. 32 bytes aligned
-  heap_end = (void *)((TYPE)((char *)ds_heap_brk - TYPE_SIZE) & BS_MASK);
-  size = (char *)heap_end - bp;
+  // update heap end. get free block size. On the BS grid
+  arena->heap_end = GRID_DOWN((char *)arena->ds_heap_brk - TYPE_SIZE);
+  size = (char *)arena->heap_end - bp;
   
-  PUT(bp, PACK(size, 0));
-  PUT(PREV_PTR(heap_end), PACK(size, 0));
-  PUT(NEXT_BLKP(bp), PACK(0, 1));
+  PUT(arena->heap_end, PACK(0, ALLOC));
+  mark_free(bp, size, prev_alloc);
 
   // coalesce if the previous block was free, heap does not shrink
   return coalesce(bp, 0);
 }
 
-// when given a single free chunk, place the requested block (split if necessary)
-static void place(void *bp, size_t req_size) {
-  LOG(1, "place(0x%p, 0x%lx (%lu))", bp, req_size, req_size);
-  assert(mm_initialized);
+// when given a single free chunk, place the requested block at offset lead (split if necessary)
+static void *place(void *bp, size_t lead, size_t req_size) {
+  LOG(1, "place(0x%p, 0x%lx, 0x%lx (%lu))", bp, lead, req_size, req_size);
+  assert(arena->heap_start != NULL);
 
-  size_t split_size = GET_SIZE(bp) - req_size;
+  size_t split_size = GET_SIZE(bp) - lead - req_size;
+  TYPE prev_alloc = GET_PREV_ALLOC(bp);
 
   // remove from free list
-  if(freelist_policy == fp_Explicit) remove_free_block(bp);
+  free_list_remove(bp);
+
+  // split off leading slack (aligned blocks)
+  if(lead > 0) {
+    mark_free(bp, lead, prev_alloc);
+    free_list_add(bp);
+    arena->stats.splits++;
+
+    bp = (char *)bp + lead;
+    prev_alloc = 0;
+  }
+
   // set header and footer
-  PUT(bp, PACK(req_size, 1));
-  PUT(HDR2FTR(bp), PACK(req_size, 1));
+  mark_alloc(bp, req_size, prev_alloc);
+  gran_update(bp, req_size, 0);
 
   // split if necessary
   if(split_size > 0) {
     void *split_bp = NEXT_BLKP(bp);
+    arena->stats.splits++;
 
     // set header and footer
-    PUT(split_bp, PACK(split_size, 0));
-    PUT(HDR2FTR(split_bp), PACK(split_size, 0));
+    mark_free(split_bp, split_size, PREV_ALLOC);
     // add to the beginning of the free list
-    if(freelist_policy == fp_Explicit) add_free_block(split_bp);
+    free_list_add(split_bp);
   }
+
+  return bp;
+}
+
+/// @brief write the boundary tags of allocated block @a bp and set the prev-alloc bit of its
+///        successor. The footer is only written if allocated blocks carry footers.
+/// @param bp pointer to header of block
+/// @param size block size in bytes
+/// @param prev_alloc PREV_ALLOC if the predecessor of @a bp is allocated, 0 otherwise
+static void mark_alloc(void *bp, size_t size, TYPE prev_alloc)
+{
+  PUT(bp, PACK(size, ALLOC | prev_alloc));
+  if(arena->footers) PUT(HDR2FTR(bp), PACK(size, ALLOC | prev_alloc));
+
+  void *next = NEXT_BLKP(bp);
+  PUT(next, GET(next) | PREV_ALLOC);
+}
+
+/// @brief write the boundary tags of free block @a bp and clear the prev-alloc bit of its
+///        successor
+/// @param bp pointer to header of block
+/// @param size block size in bytes
+/// @param prev_alloc PREV_ALLOC if the predecessor of @a bp is allocated, 0 otherwise
+static void mark_free(void *bp, size_t size, TYPE prev_alloc)
+{
+  PUT(bp, PACK(size, prev_alloc));
+  PUT(HDR2FTR(bp), PACK(size, prev_alloc));
+
+  void *next = NEXT_BLKP(bp);
+  PUT(next, GET(next) & ~PREV_ALLOC);
+}
+
+/// @brief implicit list: free blocks are found by walking the heap, nothing to do
+/// @param bp pointer to header of free block
+static void add_free_block_implicit(void *bp)
+{
 }
 
-static void add_free_block(void *bp) {
-  void *top = NEXT_LIST_GET(&first);
+/// @brief implicit list: free blocks are found by walking the heap, nothing to do
+/// @param bp pointer to header of free block
+static void remove_free_block_implicit(void *bp)
+{
+}
 
-  // bp->next = top, bp->prev = &first
-  PUT(NEXT_PTR(bp), top);
-  PUT(NEXT_NEXT_PTR(bp), &first);
-  // top->prev = split_bp, first->next = split_bp
-  PUT(NEXT_NEXT_PTR(top), bp);
-  PUT(NEXT_PTR(&first), bp);
+/// @brief explicit list: insert free block at the beginning of the free list (LIFO)
+/// @param bp pointer to header of free block
+static void add_free_block_explicit(void *bp) {
+  void *top = arena->free_head;
+
+  // bp->next = top, bp->prev = NULL
+  NEXT_LIST_SET(bp, top);
+  PREV_LIST_SET(bp, NULL);
+  // top->prev = bp, head = bp
+  if(top != NULL) PREV_LIST_SET(top, bp);
+  arena->free_head = bp;
 }
 
-static void remove_free_block(void *bp) {
+/// @brief explicit list: unlink free block from the free list
+/// @param bp pointer to header of free block
+static void remove_free_block_explicit(void *bp) {
   void *next = NEXT_LIST_GET(bp);
   void *prev = PREV_LIST_GET(bp);
 
   // bp->prev->next = bp->next, bp->next->prev = bp->prev
-  PUT(NEXT_PTR(prev), next);
-  PUT(NEXT_NEXT_PTR(next), prev);
+  if(prev != NULL) NEXT_LIST_SET(prev, next);
+  else arena->free_head = next;
+  if(next != NULL) PREV_LIST_SET(next, prev);
 
   // remove prev and next ptrs
-  PUT(NEXT_PTR(bp), 0);
-  PUT(NEXT_NEXT_PTR(bp), 0);
+  NEXT_LIST_SET(bp, NULL);
+  PREV_LIST_SET(bp, NULL);
 }
 
+/// @brief address-ordered list: insert free block between its neighbors in address order. The
+///        search starts at the closest of the insertion hint and the roving pointer that precedes
+///        @a bp, otherwise at the head.
+/// @param bp pointer to header of free block
+static void add_free_block_ordered(void *bp) {
+  void *prev = NULL;
+  void *next = arena->free_head;
+
+  if((arena->ao_hint != NULL) && (arena->ao_hint < bp)) prev = arena->ao_hint;
+  if((arena->rover != NULL) && (arena->rover < bp) && (arena->rover > prev)) prev = arena->rover;
+  if(prev != NULL) next = NEXT_LIST_GET(prev);
+
+  while((next != NULL) && (next < bp)) {
+    prev = next;
+    next = NEXT_LIST_GET(next);
+  }
 
-void* mm_malloc(size_t size)
-{
-  LOG(1, "mm_malloc(0x%lx (%lu))", size, size);
-  assert(mm_initialized);
+  // prev->next = bp, bp->next = next, next->prev = bp, bp->prev = prev
+  NEXT_LIST_SET(bp, next);
+  PREV_LIST_SET(bp, prev);
+  if(prev != NULL) NEXT_LIST_SET(prev, bp);
+  else arena->free_head = bp;
+  if(next != NULL) PREV_LIST_SET(next, bp);
+}
 
-  // ignore spurious requests
-  if(size == 0) return NULL;
+/// @brief address-ordered list: unlink free block from the free list. Its predecessor becomes
+///        the insertion hint and, if @a bp is the roving pointer, the new roving pointer.
+/// @param bp pointer to header of free block
+static void remove_free_block_ordered(void *bp) {
+  void *prev = PREV_LIST_GET(bp);
 
-  // need space for header&footer. 32 bytes aligned
-  size_t req_size = (size + TYPE_SIZE*2 + BS - 1) / BS * BS;
+  if(arena->rover == bp) arena->rover = prev;
+  arena->ao_hint = prev;
 
-  char* bp = get_free_block(req_size);
-  if(bp == NULL) { // failed to get free block, need to extend heap
-    size_t extend_size = MAX(req_size, CHUNKSIZE);
-    if((bp = extend_heap(extend_size)) == NULL) {
-      return NULL;
-    }
-  }
-  
-  place(bp, req_size);
-  // return payload pointer
-  return NEXT_PTR(bp);
+  remove_free_block_explicit(bp);
 }
 
+/// @brief bitmap: index of the granule at @a p
+#define GRAN(p)            ((size_t)((char*)(p) - (char*)arena->heap_start) >> MM_GRANULE_LOG2)
+/// @brief bitmap: header of the block starting at granule @a g
+#define GRAN_PTR(g)        ((char*)arena->heap_start + ((g) << MM_GRANULE_LOG2))
 
-void* mm_calloc(size_t nmemb, size_t size)
+/// @brief bitmap: lower the low-water marks for free block @a bp of @a size bytes
+/// @param bp pointer to header of free block
+/// @param size block size in bytes
+static void gran_lower(void *bp, size_t size)
 {
-  LOG(1, "mm_calloc(0x%lx, 0x%lx (%lu))", nmemb, size, size);
-  assert(mm_initialized);
+  size_t w = GRAN(bp) / 64;
+  for(int c = 63 - __builtin_clzl(size >> MM_GRANULE_LOG2); c >= 0; c--) {
+    if(arena->gran_low[c] <= w) break;                // marks of smaller classes are lower, too
+    arena->gran_low[c] = w;
+  }
+}
 
-  //
-  // calloc is simply malloc() followed by memset()
-  //
-  void *payload = mm_malloc(nmemb * size);
+/// @brief bitmap: mark the granules of block @a bp free or allocated. Does nothing for other
+///        policies.
+/// @param bp pointer to header of block
+/// @param size block size in bytes
+/// @param is_free 1: granules are free, 0: granules are allocated
+static void gran_update(void *bp, size_t size, int is_free)
+{
+  if(arena->freelist_policy != fp_Bitmap) return;
 
-  if (payload != NULL) memset(payload, 0, nmemb * size);
+  size_t g = GRAN(bp), end = g + (size >> MM_GRANULE_LOG2);
+  while(g < end) {
+    size_t w = g / 64, n = MIN(64 - g % 64, end - g);
+    unsigned long mask = (n < 64 ? (1UL << n) - 1 : ~0UL) << (g % 64);
 
-  return payload;
+    if(is_free) arena->gran_map[w] |= mask;
+    else arena->gran_map[w] &= ~mask;
+
+    if(arena->gran_map[w] != 0) arena->gran_sum[w / 64] |= 1UL << (w % 64);
+    else arena->gran_sum[w / 64] &= ~(1UL << (w % 64));
+
+    g += n;
+  }
+
+  if(is_free) gran_lower(bp, size);
 }
 
+/// @brief bitmap: number of free granules of block @a bp
+/// @param bp pointer to header of block
+/// @param size block size in bytes
+static size_t gran_count(void *bp, size_t size)
+{
+  size_t g = GRAN(bp), end = g + (size >> MM_GRANULE_LOG2), n = 0;
+  while(g < end) {
+    size_t k = MIN(64 - g % 64, end - g);
+    unsigned long mask = (k < 64 ? (1UL << k) - 1 : ~0UL) << (g % 64);
+    n += __builtin_popcountl(arena->gran_map[g / 64] & mask);
+    g += k;
+  }
+  return n;
+}
 
-void* mm_realloc(void *ptr, size_t size)
+/// @brief bitmap: index of the first non-zero bitmap word at or after word @a w
+/// @param w word index
+/// @param nwords number of words (returned if all words are zero)
+static size_t gran_next_word(size_t w, size_t nwords)
 {
-  LOG(1, "mm_realloc(%p, 0x%lx (%lu))", ptr, size, size);
+  if(w >= nwords) return nwords;
+
+  size_t s = w / 64;
+  unsigned long m = arena->gran_sum[s] & (~0UL << (w % 64));
+  while(m == 0) {
+    if(++s * 64 >= nwords) return nwords;
+    m = arena->gran_sum[s];
+  }
+  return MIN(s * 64 + __builtin_ctzl(m), nwords);
+}
+
+/// @brief bitmap: find and return the free block at the lowest address that has at least
+///        @a size bytes, i.e., the first run of at least size/BS set bits (first fit)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* ff_get_free_block_bitmap(size_t size)
+{
+  LOG(1, "ff_get_free_block_bitmap(0x%lx (%lu))", size, size);
+  assert(arena->heap_start != NULL);
+
+  size_t k = size >> MM_GRANULE_LOG2;
+  size_t nwords = GRAN(arena->heap_end) / 64 + 1;
+  size_t run = 0, start = 0;                          // run of set bits reaching the previous word
+  void *bp = NULL;
+
+  // blocks starting below the low-water mark are too small. If the block at the mark started in
+  // an earlier word, skip its remaining granules
+  size_t w = arena->gran_low[63 - __builtin_clzl(k)];
+  int skip = (w > 0) && (w < nwords) && (arena->gran_map[w-1] >> 63);
+
+  for(; w < nwords; w++) {
+    unsigned long x = arena->gran_map[w];
+    arena->stats.search_len++;
+
+    if(skip) {
+      if(~x == 0) continue;
+      x &= x + 1;                                     // clear the trailing ones
+      skip = 0;
+    }
+
+    // continue a run from the previous word with the trailing ones of this word
+    if(run > 0) {
+      unsigned int t = ~x ? __builtin_ctzl(~x) : 64;
+      if(run + t >= k) {
+        bp = GRAN_PTR(start);
+        w = start / 64;
+        break;
+      }
+      if(t == 64) {
+        run += 64;
+        continue;
+      }
+      run = 0;
+      x &= x + 1;                                     // clear the trailing ones
+    }
+
+    // skip allocated words using the summary bitmap
+    if(x == 0) {
+      w = gran_next_word(w + 1, nwords) - 1;
+      continue;
+    }
+
+    // a run that does not reach the next word has at most popcount(x) bits
+    if(!(x >> 63) && ((size_t)__builtin_popcountl(x) < k)) continue;
+
+    // examine the runs of this word from the lowest
+    while(x != 0) {
+      unsigned int b = __builtin_ctzl(x);
+      unsigned long y = x >> b;
+      unsigned int t = ~y ? __builtin_ctzl(~y) : 64;
+      if(t >= k) {
+        bp = GRAN_PTR(w * 64 + b);
+        break;
+      }
+      if(b + t == 64) {                               // run reaches the next word
+        run = t;
+        start = w * 64 + b;
+        break;
+      }
+      x &= x + (x & -x);                              // clear the lowest run
+    }
+    if(bp != NULL) break;
+  }
+
+  // no block of >= k granules starts below word w (nor below a run reaching the heap end)
+  if((bp == NULL) && (run > 0)) w = start / 64;
+  for(int c = 63 - __builtin_clzl(k) + ((k & (k-1)) != 0); c < 64; c++) {
+    if(arena->gran_low[c] >= w) break;                // marks of larger classes are higher, too
+    arena->gran_low[c] = w;
+  }
+
+  return bp;
+}
+
+
+/// @brief compute TLSF first- and second-level class of a block of @a size bytes
+/// @param size block size in bytes
+/// @param[out] fl first-level index
+/// @param[out] sl second-level index
+static void tlsf_mapping(size_t size, int *fl, int *sl)
+{
+  if(size < TLSF_SMALL) { // linear classes for small blocks
+    *fl = 0;
+    *sl = size / BS;
+  } else {
+    int msb = 63 - __builtin_clzl(size);
+    *fl = msb - TLSF_FL_SHIFT + 1;
+    *sl = (size >> (msb - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+  }
+}
+
+/// @brief TLSF: insert free block at the beginning of its size class list
+/// @param bp pointer to header of free block
+static void add_free_block_tlsf(void *bp)
+{
+  int fl, sl;
+  tlsf_mapping(GET_SIZE(bp), &fl, &sl);
+
+  void *top = arena->tlsf_heads[fl][sl];
+  NEXT_LIST_SET(bp, top);
+  PREV_LIST_SET(bp, NULL);
+  if(top != NULL) PREV_LIST_SET(top, bp);
+  arena->tlsf_heads[fl][sl] = bp;
+
+  arena->tlsf_fl_bitmap |= 1UL << fl;
+  arena->tlsf_sl_bitmap[fl] |= 1U << sl;
+}
+
+/// @brief TLSF: unlink free block from its size class list
+/// @param bp pointer to header of free block
+static void remove_free_block_tlsf(void *bp)
+{
+  int fl, sl;
+  tlsf_mapping(GET_SIZE(bp), &fl, &sl);
+
+  void *next = NEXT_LIST_GET(bp);
+  void *prev = PREV_LIST_GET(bp);
+
+  if(next != NULL) PREV_LIST_SET(next, prev);
+  if(prev != NULL) {
+    NEXT_LIST_SET(prev, next);
+  } else {
+    // bp was the head of its list, clear bitmaps if the list is now empty
+    arena->tlsf_heads[fl][sl] = next;
+    if(next == NULL) {
+      arena->tlsf_sl_bitmap[fl] &= ~(1U << sl);
+      if(arena->tlsf_sl_bitmap[fl] == 0) arena->tlsf_fl_bitmap &= ~(1UL << fl);
+    }
+  }
+
+  NEXT_LIST_SET(bp, NULL);
+  PREV_LIST_SET(bp, NULL);
+}
+
+/// @brief find and return a free block of at least @a size bytes (good fit, constant time)
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* gf_get_free_block_tlsf(size_t size)
+{
+  LOG(1, "gf_get_free_block_tlsf(0x%lx (%lu))", size, size);
+  assert(arena->heap_start != NULL);
+
+  // round up to the next class boundary so that every block in the selected list fits
+  if(size >= TLSF_SMALL) size += (1UL << (63 - __builtin_clzl(size) - TLSF_SL_LOG2)) - 1;
+
+  int fl, sl;
+  tlsf_mapping(size, &fl, &sl);
+  if(fl >= TLSF_FL_COUNT) return NULL;
+
+  // first try a larger or equal class on the same first level, then any larger first level
+  unsigned int sl_map = arena->tlsf_sl_bitmap[fl] & (~0U << sl);
+  if(sl_map == 0) {
+    unsigned long fl_map = (fl + 1 < TLSF_FL_COUNT) ? arena->tlsf_fl_bitmap & (~0UL << (fl + 1)) : 0;
+    if(fl_map == 0) return NULL;
+
+    fl = __builtin_ctzl(fl_map);
+    sl_map = arena->tlsf_sl_bitmap[fl];
+  }
+  sl = __builtin_ctz(sl_map);
+  arena->stats.search_len++;
+
+  return arena->tlsf_heads[fl][sl];
+}
+
+
+/// @brief compare the key (@a size, @a addr) to the key of free block @a bp
+/// @retval <0, 0, >0 if (@a size, @a addr) is smaller than, equal to, larger than @a bp
+static int tree_cmp(size_t size, void *addr, void *bp)
+{
+  size_t b_size = GET_SIZE(bp);
+
+  if(size != b_size) return size < b_size ? -1 : 1;
+  if(addr != bp) return (char*)addr < (char*)bp ? -1 : 1;
+  return 0;
+}
+
+/// @brief top-down splay of subtree @a t with key (@a size, @a addr). Afterwards, the root of
+///        the subtree is the node with the key if present, otherwise its predecessor or successor.
+/// @param t root of subtree (must not be NULL)
+/// @param size size component of key
+/// @param addr address component of key
+/// @retval void* new root of subtree
+static void* tree_splay(void *t, size_t size, void *addr)
+{
+  TYPE n[4];                                          // left/right tree assembled below n
+  void *l = n, *r = n;
+  TREE_SET_LEFT(n, NULL);
+  TREE_SET_RIGHT(n, NULL);
+
+  while(1) {
+    int c = tree_cmp(size, addr, t);
+    arena->tree_steps++;
+
+    if(c < 0) {
+      if(TREE_LEFT(t) == NULL) break;
+      if(tree_cmp(size, addr, TREE_LEFT(t)) < 0) { // rotate right
+        void *y = TREE_LEFT(t);
+        TREE_SET_LEFT(t, TREE_RIGHT(y));
+        TREE_SET_RIGHT(y, t);
+        t = y;
+        if(TREE_LEFT(t) == NULL) break;
+      }
+      TREE_SET_LEFT(r, t);                               // link right
+      r = t;
+      t = TREE_LEFT(t);
+    } else if(c > 0) {
+      if(TREE_RIGHT(t) == NULL) break;
+      if(tree_cmp(size, addr, TREE_RIGHT(t)) > 0) { // rotate left
+        void *y = TREE_RIGHT(t);
+        TREE_SET_RIGHT(t, TREE_LEFT(y));
+        TREE_SET_LEFT(y, t);
+        t = y;
+        if(TREE_RIGHT(t) == NULL) break;
+      }
+      TREE_SET_RIGHT(l, t);                              // link left
+      l = t;
+      t = TREE_RIGHT(t);
+    } else {
+      break;
+    }
+  }
+
+  // assemble
+  TREE_SET_RIGHT(l, TREE_LEFT(t));
+  TREE_SET_LEFT(r, TREE_RIGHT(t));
+  TREE_SET_LEFT(t, TREE_RIGHT(n));
+  TREE_SET_RIGHT(t, TREE_LEFT(n));
+
+  return t;
+}
+
+/// @brief splay tree: insert free block into tree. The new block becomes the root.
+/// @param bp pointer to header of free block
+static void add_free_block_tree(void *bp)
+{
+  if(arena->tree_root == NULL) {
+    TREE_SET_LEFT(bp, NULL);
+    TREE_SET_RIGHT(bp, NULL);
+  } else {
+    size_t size = GET_SIZE(bp);
+    void *t = tree_splay(arena->tree_root, size, bp);
+
+    if(tree_cmp(size, bp, t) < 0) {
+      TREE_SET_LEFT(bp, TREE_LEFT(t));
+      TREE_SET_RIGHT(bp, t);
+      TREE_SET_LEFT(t, NULL);
+    } else {
+      TREE_SET_RIGHT(bp, TREE_RIGHT(t));
+      TREE_SET_LEFT(bp, t);
+      TREE_SET_RIGHT(t, NULL);
+    }
+  }
+  arena->tree_root = bp;
+}
+
+/// @brief splay tree: remove free block from tree
+/// @param bp pointer to header of free block
+static void remove_free_block_tree(void *bp)
+{
+  size_t size = GET_SIZE(bp);
+  void *t = tree_splay(arena->tree_root, size, bp);
+  assert(t == bp);
+
+  if(TREE_LEFT(t) == NULL) {
+    arena->tree_root = TREE_RIGHT(t);
+  } else {
+    // splaying the left subtree with bp's key moves its maximum to the root
+    arena->tree_root = tree_splay(TREE_LEFT(t), size, bp);
+    TREE_SET_RIGHT(arena->tree_root, TREE_RIGHT(t));
+  }
+
+  TREE_SET_LEFT(bp, NULL);
+  TREE_SET_RIGHT(bp, NULL);
+}
+
+/// @brief find and return a free block of at least @a size bytes (best fit, amortized O(log n))
+/// @param size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if no free block of the requested size is avilable
+static void* bf_get_free_block_tree(size_t size)
+{
+  LOG(1, "bf_get_free_block_tree(0x%lx (%lu))", size, size);
+  assert(arena->heap_start != NULL);
+
+  if(arena->tree_root == NULL) return NULL;
+  size_t steps = arena->tree_steps;
+
+  // (size, NULL) is smaller than all blocks of the same size; the root is now either the
+  // best fit or its predecessor
+  arena->tree_root = tree_splay(arena->tree_root, size, NULL);
+  arena->stats.search_len += arena->tree_steps - steps;
+  if(GET_SIZE(arena->tree_root) >= size) return arena->tree_root;
+
+  // best fit is the minimum of the right subtree
+  if(TREE_RIGHT(arena->tree_root) == NULL) return NULL;
+  steps = arena->tree_steps;
+  TREE_SET_RIGHT(arena->tree_root, tree_splay(TREE_RIGHT(arena->tree_root), size, NULL));
+  arena->stats.search_len += arena->tree_steps - steps;
+
+  return TREE_RIGHT(arena->tree_root);
+}
+
+
+/// @brief find a free block of at least @a req_size bytes in the free list(s), extending the heap
+///        if necessary. The block remains in the free list.
+/// @param req_size block size (including boundary tags), in bytes
+/// @retval void* pointer to header of free block
+/// @retval NULL if the heap cannot be extended
+static void* fit_block(size_t req_size)
+{
+  char* bp = free_list_get(req_size);
+  if((bp == NULL) && (arena->quick_bytes > 0)) { // consolidate quick bins and retry
+    quick_consolidate();
+    bp = free_list_get(req_size);
+  }
+  if(bp == NULL) { // failed to get free block, need to extend heap
+    // grow geometrically if the last extension was recent. The step is limited to a fraction
+    // of the heap so that the unused tail stays small relative to the heap size
+    if(arena->clock - arena->last_grow <= mm_trim_delay) {
+      size_t heap_size = (char*)arena->heap_end - (char*)arena->heap_start;
+      size_t limit = MIN(mm_grow_max, heap_size >> GROW_SHIFT);
+      arena->grow_step = MAX(MIN(2 * arena->grow_step, limit), mm_grow_min);
+    } else {
+      arena->grow_step = mm_grow_min;
+    }
+
+    size_t extend_size = MAX(req_size, arena->grow_step);
+    if((bp = extend_heap(extend_size)) == NULL) {
+      // retry with the exact size if the step does not fit into the data segment
+      if((extend_size == req_size) || ((bp = extend_heap(req_size)) == NULL)) return NULL;
+    }
+    arena->last_grow = arena->clock;
+  }
+  arena->clock++;
+
+  return bp;
+}
+
+/// @brief allocate a block of @a req_size bytes from the free list(s), extending the heap if
+///        necessary
+/// @param req_size block size (including boundary tags), in bytes
+/// @retval void* pointer to header of allocated block
+/// @retval NULL if the heap cannot be extended
+static void* alloc_block(size_t req_size)
+{
+  char *bp = fit_block(req_size);
+  if(bp == NULL) return NULL;
+
+  return place(bp, 0, req_size);
+}
+
+/// @brief free allocated block @a bp and coalesce it with its neighbors. Shrinks heap if needed.
+/// @param bp pointer to header of allocated block
+static void free_block(void *bp)
+{
+  // update header and footer's status bits
+  size_t size = GET_SIZE(bp);
+  mark_free(bp, size, GET_PREV_ALLOC(bp));
+
+  // coalesce the block, shrinks heap if needed
+  arena->clock++;
+  coalesce(bp, 1);
+}
+
+
+/// @brief insert slab run at the beginning of the list of runs with free slots of its class
+/// @param run slab run
+static void slab_link(struct SlabRun *run)
+{
+  run->prev = NULL;
+  run->next = arena->slab_partial[run->cls];
+  if(run->next != NULL) run->next->prev = run;
+  arena->slab_partial[run->cls] = run;
+}
+
+/// @brief remove slab run from the list of runs with free slots of its class
+/// @param run slab run
+static void slab_unlink(struct SlabRun *run)
+{
+  if(run->next != NULL) run->next->prev = run->prev;
+  if(run->prev != NULL) run->prev->next = run->next;
+  else arena->slab_partial[run->cls] = run->next;
+}
+
+/// @brief carve a new slab run for size class @a cls out of the heap
+/// @param cls size class
+/// @retval struct SlabRun* new run (linked into the list of runs with free slots)
+/// @retval NULL if the heap cannot be extended
+static struct SlabRun* slab_new_run(unsigned int cls)
+{
+  char *bp = alloc_block(SLAB_RUN_SIZE);
+  if(bp == NULL) return NULL;
+  PUT(bp, GET(bp) | SLAB);
+
+  struct SlabRun *run = (struct SlabRun*)NEXT_PTR(bp);
+  run->cls = cls;
+  run->stride = (cls + 1) * SLAB_ALIGN;
+  run->nslots = (SLAB_RUN_SIZE - SLAB_FIRST - (ALLOC_OVERHEAD - TYPE_SIZE)) / run->stride;
+  if(run->nslots > SLAB_MAP_WORDS * 64) run->nslots = SLAB_MAP_WORDS * 64;
+  run->nfree = run->nslots;
+
+  // mark all slots free and write the slot tags once
+  memset(run->map, 0, sizeof(run->map));
+  for(unsigned int i = 0; i < run->nslots; i++) {
+    size_t ofs = SLAB_FIRST + i * run->stride;
+    run->map[i / 64] |= 1UL << (i % 64);
+    PUT(bp + ofs, PACK_TAG(ofs, TAG_SLAB));
+  }
+
+  slab_link(run);
+  return run;
+}
+
+/// @brief allocate an object of @a size bytes from a slab run
+/// @param size requested size in bytes (<= SLAB_MAX)
+/// @retval void* pointer to object
+/// @retval NULL if a new run was required and the heap cannot be extended
+static void* slab_malloc(size_t size)
+{
+  unsigned int cls = SLAB_CLASS(size);
+  struct SlabRun *run = arena->slab_partial[cls];
+
+  if(run != NULL) {
+    arena->stats.slab_hits++;
+  } else {
+    arena->stats.slab_misses++;
+    if((run = slab_new_run(cls)) == NULL) return NULL;
+  }
+
+  // find first free slot
+  unsigned int w = 0;
+  while(run->map[w] == 0) w++;
+  unsigned int idx = w * 64 + __builtin_ctzl(run->map[w]);
+  run->map[w] &= run->map[w] - 1;
+
+  if(--run->nfree == 0) slab_unlink(run);
+
+  char *bp = (char*)PREV_PTR(run);
+  return NEXT_PTR(bp + SLAB_FIRST + idx * run->stride);
+}
+
+/// @brief return an object to its slab run
+/// @param ptr pointer to object (preceded by a slab tag)
+static void slab_free(void *ptr)
+{
+  char *tag = PREV_PTR(ptr);
+  char *bp = tag - TAG_OFS(GET(tag));
+  struct SlabRun *run = (struct SlabRun*)NEXT_PTR(bp);
+
+  unsigned int idx = (tag - bp - SLAB_FIRST) / run->stride;
+  unsigned long bit = 1UL << (idx % 64);
+  if(run->map[idx / 64] & bit) {
+    printf("double free error!");
+    return;
+  }
+  run->map[idx / 64] |= bit;
+
+  if(run->nfree++ == 0) slab_link(run);
+
+  // release empty run unless it is the only run of its class with free slots
+  if((run->nfree == run->nslots) && ((run->prev != NULL) || (run->next != NULL))) {
+    slab_unlink(run);
+    free_block(bp);
+  }
+}
+
+/// @brief payload capacity of slab object @a ptr
+/// @param ptr pointer to object (preceded by a slab tag)
+static size_t slab_size(void *ptr)
+{
+  char *tag = PREV_PTR(ptr);
+  struct SlabRun *run = (struct SlabRun*)NEXT_PTR(tag - TAG_OFS(GET(tag)));
+
+  return run->stride - TYPE_SIZE;
+}
+
+
+/// @brief allocate a large object of @a size bytes in its own mapping
+/// @param size requested size in bytes
+/// @retval void* pointer to first byte of memory on success
+/// @retval NULL if memory allocation failed
+static void* mmap_malloc(size_t size)
+{
+  if(size > SIZE_MAX - MMAP_HDR - PAGESIZE) return NULL;
+  size_t map_size = (size + MMAP_HDR + PAGESIZE-1) & ~((size_t)PAGESIZE-1);
+
+  char *m = ds_mmap(map_size);
+  if(m == (void*)-1) return NULL;
+
+  MMAP_SIZE(m) = map_size;
+  PUT(m + MMAP_HDR - TYPE_SIZE, PACK_TAG(MMAP_HDR - TYPE_SIZE, TAG_MMAP));
+
+  return m + MMAP_HDR;
+}
+
+/// @brief resize mapped object @a ptr to @a size bytes. Pages are remapped, not copied.
+/// @param ptr pointer to mapped object
+/// @param size requested new size in bytes
+/// @retval void* pointer to first byte of resized object on success
+/// @retval NULL if the mapping could not be resized (@a ptr is left untouched)
+static void* mmap_realloc(void *ptr, size_t size)
+{
+  char *m = (char*)ptr - MMAP_HDR;
+  size_t old_size = MMAP_SIZE(m);
+
+  if(size > SIZE_MAX - MMAP_HDR - PAGESIZE) return NULL;
+  size_t map_size = (size + MMAP_HDR + PAGESIZE-1) & ~((size_t)PAGESIZE-1);
+  if(map_size == old_size) return ptr;
+
+  m = ds_mremap(m, old_size, map_size);
+  if(m == (void*)-1) return NULL;
+
+  MMAP_SIZE(m) = map_size;
+  return m + MMAP_HDR;
+}
+
+/// @brief release mapped object @a ptr
+/// @param ptr pointer to mapped object
+static void mmap_free(void *ptr)
+{
+  char *m = (char*)ptr - MMAP_HDR;
+
+  if(ds_munmap(m, MMAP_SIZE(m)) != 0) printf("munmap() of large object failed");
+}
+
+/// @brief pop the most recently freed block of size @a req_size from its quick bin
+/// @param req_size block size (<= QUICK_MAX)
+/// @retval void* pointer to header of allocated block
+/// @retval NULL if the bin is empty
+static void* quick_get(size_t req_size)
+{
+  void **bin = &arena->quick_bins[req_size / BS - 1];
+  void *bp = *bin;
+  if(bp == NULL) return NULL;
+
+  *bin = NEXT_LIST_GET(bp);
+  arena->quick_bytes -= req_size;
+
+  return bp;
+}
+
+/// @brief push allocated block @a bp onto its quick bin. Consolidates the quick bins if they
+///        hold too large a part of the heap.
+/// @param bp pointer to header of allocated block (size <= QUICK_MAX)
+static void quick_put(void *bp)
+{
+  size_t size = GET_SIZE(bp);
+  void **bin = &arena->quick_bins[size / BS - 1];
+
+  // catch the simplest case of a double free
+  if(*bin == bp) {
+    printf("double free error!");
+    return;
+  }
+
+  NEXT_LIST_SET(bp, *bin);
+  *bin = bp;
+  arena->verify_freed = bp;
+  arena->quick_bytes += size;
+
+  size_t heap_size = (char*)arena->heap_end - (char*)arena->heap_start;
+  if(arena->quick_bytes > (heap_size >> QUICK_FRAG_SHIFT)) quick_consolidate();
+}
+
+/// @brief free and coalesce all blocks in the quick bins
+static void quick_consolidate(void)
+{
+  LOG(2, "quick_consolidate() (%lu bytes)", arena->quick_bytes);
+
+  for(int i = 0; i < QUICK_BINS; i++) {
+    void *bp = arena->quick_bins[i];
+    arena->quick_bins[i] = NULL;
+
+    while(bp != NULL) {
+      void *next = NEXT_LIST_GET(bp);
+      free_block(bp);
+      bp = next;
+    }
+  }
+
+  arena->quick_bytes = 0;
+}
+
+/// @brief allocate a block of memory of @a size bytes in the current arena
+/// @param size requested size in bytes (> 0)
+/// @retval void* pointer to first byte of memory on success
+/// @retval NULL if memory allocation failed
+static void* arena_malloc(size_t size)
+{
+  // large requests get their own mapping (not in heaps created by mm_heap_create(), which must
+  // own all of their memory)
+  if(mm_mmap_thld && !arena->handle && (size >= mm_mmap_thld)) return mmap_malloc(size);
+
+  // small requests are served by the slab front-end
+  if(arena->slab && (size <= SLAB_MAX)) return slab_malloc(size);
+
+  // need space for header&footer. 32 bytes aligned
+  size_t req_size = REQ_SIZE(size);
+
+  // exact fit from quick bin
+  if(arena->quick && (req_size <= QUICK_MAX)) {
+    char *bp = quick_get(req_size);
+    if(bp != NULL) return NEXT_PTR(bp);
+  }
+
+  char* bp = alloc_block(req_size);
+  if(bp == NULL) return NULL;
+
+  // return payload pointer
+  return NEXT_PTR(bp);
+}
+
+/// @brief allocate a block of memory of @a size bytes aligned to @a align in the current arena
+/// @param align alignment (power of two, > PAYLOAD_ALIGN)
+/// @param size requested size in bytes (> 0)
+/// @retval void* pointer to first byte of memory on success
+/// @retval NULL if memory allocation failed
+static void* arena_memalign(size_t align, size_t size)
+{
+  // offset of the payload from the header: room for header and tag, such that the header is on
+  // the BS grid when the payload is aligned
+  size_t ofs = ((HDR_OFS + 2*TYPE_SIZE + MIN(align, BS)-1) & ~(MIN(align, BS)-1)) - HDR_OFS;
+  size_t slack = (align > BS) ? align - BS : 0;
+  if(size > SIZE_MAX - ofs - slack - 2*BS) return NULL;
+
+  size_t req_size = REQ_SIZE(size + ofs - TYPE_SIZE);
+
+  char *bp = fit_block(req_size + slack);
+  if(bp == NULL) return NULL;
+
+  // the header goes ofs bytes before the first aligned address that leaves room for it
+  char *payload = (char*)(((uintptr_t)bp + ofs + align-1) & ~(uintptr_t)(align-1));
+  bp = place(bp, payload - ofs - bp, req_size);
+
+  PUT(PREV_PTR(payload), PACK_TAG(PREV_PTR(payload) - bp, TAG_ALIGN));
+  return payload;
+}
+
+/// @brief payload pointer of the block holding aligned payload @a ptr
+/// @param ptr pointer returned by arena_memalign()
+static void* aligned_base(void *ptr)
+{
+  char *tag = PREV_PTR(ptr);
+  return NEXT_PTR(tag - TAG_OFS(GET(tag)));
+}
+
+
+/// @brief check whether the block with payload @a ptr was recently returned by realloc()
+/// @param ptr payload pointer
+/// @retval 1 if @a ptr is in the realloc history, 0 otherwise
+static int realloc_repeated(void *ptr)
+{
+  for(int i = 0; i < REALLOC_HIST; i++) {
+    if(arena->realloc_hist[i] == ptr) return 1;
+  }
+  return 0;
+}
+
+/// @brief record that realloc() moved/resized the block with payload @a old_ptr to @a new_ptr
+/// @param old_ptr payload pointer passed to realloc()
+/// @param new_ptr payload pointer returned by realloc()
+static void realloc_note(void *old_ptr, void *new_ptr)
+{
+  for(int i = 0; i < REALLOC_HIST; i++) {
+    if(arena->realloc_hist[i] == old_ptr) {
+      arena->realloc_hist[i] = new_ptr;
+      return;
+    }
+  }
+
+  arena->realloc_hist[arena->realloc_next] = new_ptr;
+  arena->realloc_next = (arena->realloc_next + 1) % REALLOC_HIST;
+}
+
+/// @brief turn the @a total bytes starting at @a bp into an allocated block of @a grow_size
+///        bytes (or @a new_size bytes if @a total is too small) and a free remainder
+/// @param bp pointer to header of new block
+/// @param total number of bytes available at @a bp (>= @a new_size)
+/// @param new_size minimal block size
+/// @param grow_size preferred block size (>= @a new_size)
+/// @param prev_alloc PREV_ALLOC if the predecessor of @a bp is allocated, 0 otherwise
+/// @retval payload pointer of the block
+static void* realloc_place(void *bp, size_t total, size_t new_size, size_t grow_size,
+                           TYPE prev_alloc)
+{
+  size_t size = total >= grow_size ? grow_size : new_size;
+  mark_alloc(bp, size, prev_alloc);
+  gran_update(bp, size, 0);
+
+  // split the remainder and add it to the free list
+  if(total > size) {
+    void *split_bp = NEXT_BLKP(bp);
+    mark_free(split_bp, total - size, PREV_ALLOC);
+    gran_update(split_bp, total - size, 1);
+    arena->stats.splits++;
+    free_list_add(split_bp);
+  }
+
+  return NEXT_PTR(bp);
+}
+
+/// @brief grow allocated block @a bp without moving it to another place in the heap: merge
+///        with a free successor, extend the heap if @a bp is the last block, or merge with a
+///        free predecessor and move the payload backwards.
+/// @param bp pointer to header of allocated block
+/// @param old_size current block size
+/// @param new_size minimal block size
+/// @param grow_size preferred block size (>= @a new_size)
+/// @retval payload pointer of the grown block on success
+/// @retval NULL if the block cannot be grown in place
+static void* realloc_grow(void *bp, size_t old_size, size_t new_size, size_t grow_size)
+{
+  TYPE prev_alloc = GET_PREV_ALLOC(bp);
+  char *prev_bp = prev_alloc ? NULL : PREV_BLKP(bp);
+  size_t prev_size = prev_bp ? GET_SIZE(prev_bp) : 0;
+  char *next_bp = NEXT_BLKP(bp);
+  size_t next_size = GET_STATUS(next_bp) ? 0 : GET_SIZE(next_bp);
+
+  // merge with free successor
+  if(old_size + next_size >= new_size) {
+    if(next_size > 0) free_list_remove(next_bp);
+    return realloc_place(bp, old_size + next_size, new_size, grow_size, prev_alloc);
+  }
+
+  // last block in heap: extend the heap. extend_heap() merges the new space with a free successor
+  if((char*)bp + old_size + next_size == (char*)arena->heap_end) {
+    if((extend_heap(grow_size - old_size - next_size) != NULL) ||
+       (extend_heap(new_size - old_size - next_size) != NULL)) {
+      arena->last_grow = arena->clock;
+
+      next_bp = NEXT_BLKP(bp);
+      next_size = GET_SIZE(next_bp);
+      free_list_remove(next_bp);
+      return realloc_place(bp, old_size + next_size, new_size, grow_size, prev_alloc);
+    }
+  }
+
+  // merge with free predecessor (and successor), move payload backwards
+  if(prev_size + old_size + next_size >= new_size) {
+    free_list_remove(prev_bp);
+    if(next_size > 0) free_list_remove(next_bp);
+
+    memmove(NEXT_PTR(prev_bp), NEXT_PTR(bp), old_size - ALLOC_OVERHEAD);
+    return realloc_place(prev_bp, prev_size + old_size + next_size, new_size, grow_size,
+                         GET_PREV_ALLOC(prev_bp));
+  }
+
+  return NULL;
+}
+
+/// @brief re-allocate block @a ptr of the current arena to @a size bytes
+/// @param ptr previously allocated block (not NULL)
+/// @param size requested new size in bytes (> 0)
+/// @retval void* pointer to first byte of re-allocated memory on success
+/// @retval NULL if memory allocation failed (@a ptr is left untouched)
+static void* arena_realloc(void *ptr, size_t size)
+{
+  // aligned block: the alignment need not be preserved, move the payload to an ordinary block
+  if(IS_ALIGNED(ptr)) {
+    size_t old_size = payload_size(ptr);
+
+    void *new_ptr = arena_malloc(size);
+    if(new_ptr) {
+      memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+      free_block(PREV_PTR(aligned_base(ptr)));
+    }
+    return new_ptr;
+  }
+
+  // slab object: keep it if the new size falls into the same class, otherwise move it
+  if(GET(PREV_PTR(ptr)) & TAG) {
+    size_t old_size = slab_size(ptr);
+    if(arena->slab && (size <= SLAB_MAX) && (SLAB_CLASS(size) == SLAB_CLASS(old_size))) return ptr;
+
+    void *new_ptr = arena_malloc(size);
+    if(new_ptr) {
+      memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+      slab_free(ptr);
+    }
+    return new_ptr;
+  }
+
+  // payload pointer -> block pointer
+  ptr = PREV_PTR(ptr);
+  if(GET_STATUS(ptr) == 0) {
+    printf("realloc() of free block");
+    return NULL;
+  }
+
+  size_t old_size = GET_SIZE(ptr);
+  size_t new_size = REQ_SIZE(size);
+
+  if(old_size == new_size) return NEXT_PTR(ptr);
+
+  if(old_size > new_size) { // if the block is large enough, split it
+    mark_alloc(ptr, new_size, GET_PREV_ALLOC(ptr));
+
+    size_t split_size = old_size - new_size;
+    void *split_ptr = NEXT_BLKP(ptr);
+    mark_free(split_ptr, split_size, PREV_ALLOC);
+    arena->stats.splits++;
+
+    // merge with a free successor and add to the free list
+    coalesce(split_ptr, 0);
+    return NEXT_PTR(ptr);
+  }
+
+  // blocks that are grown repeatedly are over-allocated geometrically
+  size_t grow_size = new_size;
+  if(realloc_repeated(NEXT_PTR(ptr))) {
+    size_t extra = MIN(old_size / 2, mm_grow_max);
+    grow_size = MAX(new_size, (old_size + extra) & BS_MASK);
+  }
+
+  void *result = realloc_grow(ptr, old_size, new_size, grow_size);
+  if(result == NULL) {
+    // move the block
+    result = arena_malloc(grow_size - ALLOC_OVERHEAD);
+    if(result == NULL) result = arena_malloc(size);
+    if(result == NULL) return NULL;
+
+    memcpy(result, NEXT_PTR(ptr), old_size - ALLOC_OVERHEAD);
+    free_block(ptr);
+  }
+
+  realloc_note(NEXT_PTR(ptr), result);
+  return result;
+}
+
+
+/// @brief free block @a ptr of the current arena
+/// @param ptr pointer to allocated memory (not NULL)
+static void arena_free(void *ptr)
+{
+  arena->verify_freed = NULL;
+
+  // aligned block
+  if(IS_ALIGNED(ptr)) ptr = aligned_base(ptr);
+
+  // slab object
+  if(GET(PREV_PTR(ptr)) & TAG) {
+    slab_free(ptr);
+    return;
+  }
+
+  ptr = PREV_PTR(ptr);
+  if(GET_STATUS(ptr) == 0) {
+    printf("double free error!");
+    return;
+  }
+
+  // defer coalescing of small blocks
+  if(arena->quick && (GET_SIZE(ptr) <= QUICK_MAX)) {
+    quick_put(ptr);
+    return;
+  }
+  
+  free_block(ptr);
+}
+
+/// @brief allocate @a n blocks of @a size bytes in the current arena from one carved region
+/// @param size requested size in bytes (> 0)
+/// @param n number of blocks
+/// @param[out] ptrs array receiving the @a n payload pointers
+/// @retval number of blocks allocated (< @a n if memory allocation failed)
+static size_t arena_malloc_batch(size_t size, size_t n, void **ptrs)
+{
+  size_t i = 0;
+
+  // small requests are served by the slab front-end
+  if(arena->slab && (size <= SLAB_MAX)) {
+    while((i < n) && ((ptrs[i] = slab_malloc(size)) != NULL)) i++;
+    return i;
+  }
+
+  size_t req_size = REQ_SIZE(size);
+
+  // get one block for all requests. If none is available, allocate the blocks one by one
+  char *bp = (n <= SIZE_MAX / req_size) ? alloc_block(n * req_size) : NULL;
+  if(bp == NULL) {
+    while((i < n) && ((ptrs[i] = arena_malloc(size)) != NULL)) i++;
+    return i;
+  }
+
+  // carve the block. The last block receives the remainder that place() did not split off
+  size_t size_left = GET_SIZE(bp);
+  TYPE prev_alloc = GET_PREV_ALLOC(bp);
+  for(i = 0; i < n; i++) {
+    size_t bsize = (i < n-1) ? req_size : size_left;
+    mark_alloc(bp, bsize, prev_alloc);
+    ptrs[i] = NEXT_PTR(bp);
+
+    prev_alloc = PREV_ALLOC;
+    size_left -= bsize;
+    bp += bsize;
+  }
+
+  return n;
+}
+
+/// @brief free @a n blocks of the current arena. Physically adjacent blocks are merged and
+///        coalesced with their neighbors once.
+/// @param ptrs array of pointers to allocated memory, sorted by address (no NULL entries)
+/// @param n number of pointers
+static void arena_free_batch(void **ptrs, size_t n)
+{
+  arena->verify_freed = NULL;
+
+  size_t i = 0;
+
+  while(i < n) {
+    void *ptr = ptrs[i++];
+
+    // aligned block
+    if(IS_ALIGNED(ptr)) ptr = aligned_base(ptr);
+
+    // slab object
+    if(GET(PREV_PTR(ptr)) & TAG) {
+      slab_free(ptr);
+      continue;
+    }
+
+    char *bp = PREV_PTR(ptr);
+    if(GET_STATUS(bp) == 0) {
+      printf("double free error!");
+      continue;
+    }
+
+    // extend over the following blocks as long as they are adjacent and allocated
+    size_t size = GET_SIZE(bp);
+    while(i < n) {
+      char *next = PREV_PTR(IS_ALIGNED(ptrs[i]) ? aligned_base(ptrs[i]) : ptrs[i]);
+      if((next != bp + size) || (GET(next) & TAG) || (GET_STATUS(next) == 0)) break;
+
+      size += GET_SIZE(next);
+      arena->stats.coalesces++;
+      i++;
+    }
+
+    mark_free(bp, size, GET_PREV_ALLOC(bp));
+    coalesce(bp, 1);
+  }
+}
+
+
+/// @brief payload capacity of allocated block, slab object, or mapped object @a ptr
+/// @param ptr pointer to allocated memory
+static size_t payload_size(void *ptr)
+{
+  if(IS_MMAPPED(ptr)) return MMAP_SIZE((char*)ptr - MMAP_HDR) - MMAP_HDR;
+  if(IS_ALIGNED(ptr)) {
+    char *base = aligned_base(ptr);
+    return GET_SIZE(PREV_PTR(base)) - ALLOC_OVERHEAD - ((char*)ptr - base);
+  }
+  if(GET(PREV_PTR(ptr)) & TAG) return slab_size(ptr);
+  return GET_SIZE(PREV_PTR(ptr)) - ALLOC_OVERHEAD;
+}
+
+
+/// @brief arena owning the memory at @a ptr
+/// @param ptr pointer into the heap
+static struct Arena* arena_of(void *ptr)
+{
+  if(mm_narenas == 0) return &arenas[0];
+
+  return &arenas[((char*)ptr - (char*)arenas[0].ds_heap_start) / arena_slice];
+}
+
+/// @brief make @a a the current arena and lock it. Blocks freed remotely by other threads are
+///        released before returning.
+/// @param a arena
+static void arena_lock(struct Arena *a)
+{
+  arena = a;
+  pthread_mutex_lock(&arena->lock);
+
+  if(__atomic_load_n(&arena->remote_free, __ATOMIC_RELAXED) != NULL) {
+    void *ptr = __atomic_exchange_n(&arena->remote_free, NULL, __ATOMIC_ACQUIRE);
+    while(ptr != NULL) {
+      void *next = *(void**)ptr;
+      arena_free(ptr);
+      ptr = next;
+    }
+  }
+}
+
+/// @brief push block @a ptr onto the remote-free list of arena @a a. Lock-free; safe to call
+///        concurrently from any number of threads.
+/// @param a arena owning @a ptr
+/// @param ptr pointer to allocated memory
+static void arena_remote_free(struct Arena *a, void *ptr)
+{
+  void *head = __atomic_load_n(&a->remote_free, __ATOMIC_RELAXED);
+  do {
+    *(void**)ptr = head;
+  } while(!__atomic_compare_exchange_n(&a->remote_free, &head, ptr, 1,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/// @brief validate the thread cache of the calling thread and assign a home arena on first use
+static void tcache_setup(void)
+{
+  if(tcache.generation != mm_generation) {
+    memset(&tcache, 0, sizeof(tcache));
+    tcache.generation = mm_generation;
+    tcache.home = __atomic_fetch_add(&arena_next, 1, __ATOMIC_RELAXED) % mm_narenas;
+
+    // register the cache so that it gets flushed when the thread exits
+    pthread_setspecific(tcache_key, &tcache);
+  }
+}
+
+/// @brief take a block for a request of @a size bytes from the thread cache
+/// @param size requested size in bytes
+/// @retval void* payload pointer of cached block
+/// @retval NULL if the request is not cacheable or the bin is empty
+static void* tcache_get(size_t size)
+{
+  if(arena->slab && (size <= SLAB_MAX)) return NULL;
+
+  size_t req_size = REQ_SIZE(size);
+  if(req_size > TCACHE_MAX) return NULL;
+
+  int i = req_size / BS - 1;
+  void *bp = tcache.bin[i];
+  if(bp == NULL) return NULL;
+
+  tcache.bin[i] = NEXT_LIST_GET(bp);
+  tcache.count[i]--;
+
+  return NEXT_PTR(bp);
+}
+
+/// @brief put allocated block @a bp into the thread cache
+/// @param bp pointer to header of allocated block
+/// @param size size of block
+/// @retval 1 if the block was cached
+/// @retval 0 if the block is too large or the bin is full
+static int tcache_put(void *bp, size_t size)
+{
+  if(size > TCACHE_MAX) return 0;
+
+  int i = size / BS - 1;
+  if(tcache.count[i] >= TCACHE_FILL) return 0;
+
+  NEXT_LIST_SET(bp, tcache.bin[i]);
+  tcache.bin[i] = bp;
+  tcache.count[i]++;
+
+  return 1;
+}
+
+
+/// @brief check whether @a p is a plausible block header of the current arena
+/// @param p pointer
+/// @retval 1 if @a p is on the BS grid and lies within the heap, 0 otherwise
+static int in_heap(void *p)
+{
+  return ((char*)p >= (char*)arena->heap_start) && ((char*)p < (char*)arena->heap_end) &&
+         ON_GRID(p);
+}
+
+/// @brief check the invariants of block @a p that can be verified locally: footer, free
+///        predecessor, and the links of a free block in the free list(s)
+/// @param p pointer to header of block with a sane size
+/// @retval number of violated invariants
+static size_t verify_block(void *p)
+{
+  size_t errors = 0;
+  TYPE hdr = GET(p);
+  size_t size = SIZE(hdr);
+
+  // allocated blocks have no footer in the footerless layout
+  if((STATUS(hdr) == FREE) || arena->footers) {
+    TYPE ftr = GET((char*)p + size - TYPE_SIZE);
+    if((SIZE(ftr) != size) || (STATUS(ftr) != STATUS(hdr))) {
+      LOG(1, "mm_verify: footer of %p does not match header", p);
+      errors++;
+    }
+  }
+
+  // the granules of a block are marked in the bitmap iff it is free
+  if((arena->freelist_policy == fp_Bitmap) &&
+     (gran_count(p, size) != (STATUS(hdr) == FREE ? size >> MM_GRANULE_LOG2 : 0))) {
+    LOG(1, "mm_verify: granule bitmap does not match status of %p", p);
+    errors++;
+  }
+
+  if(STATUS(hdr) == ALLOC) return errors;
+
+  // a free block must not follow another free block
+  if(!(hdr & PREV_ALLOC)) {
+    LOG(1, "mm_verify: adjacent free blocks at %p", p);
+    errors++;
+  }
+
+  // links to the neighbors in the free list(s)
+  void *next = NEXT_LIST_GET(p), *prev = PREV_LIST_GET(p);
+  switch(arena->freelist_policy) {
+    case fp_FirstFit:
+    case fp_NextFit:
+    case fp_BestFit:
+    case fp_GoodFit:
+      if(((next != NULL) && (next <= p)) || ((prev != NULL) && (prev >= p))) {
+        LOG(1, "mm_verify: free list neighbors of %p out of address order", p);
+        errors++;
+      }
+      // fall through
+    case fp_Explicit:
+    case fp_TLSF: {
+      void **head = &arena->free_head;
+      if(arena->freelist_policy == fp_TLSF) {
+        int fl, sl;
+        tlsf_mapping(size, &fl, &sl);
+        head = &arena->tlsf_heads[fl][sl];
+      }
+      if(((next != NULL) && (!in_heap(next) || (PREV_LIST_GET(next) != p))) ||
+         ((prev != NULL) && (!in_heap(prev) || (NEXT_LIST_GET(prev) != p))) ||
+         ((prev == NULL) && (*head != p))) {
+        LOG(1, "mm_verify: broken free list links of %p", p);
+        errors++;
+      }
+      break;
+    }
+
+    case fp_SplayTree:
+      if(((next != NULL) && (!in_heap(next) || (tree_cmp(size, p, next) <= 0))) ||
+         ((prev != NULL) && (!in_heap(prev) || (tree_cmp(size, p, prev) >= 0)))) {
+        LOG(1, "mm_verify: children of %p out of order", p);
+        errors++;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return errors;
+}
+
+/// @brief verify up to @a nblocks consecutive blocks starting at block @a p
+/// @param p pointer to header of first block
+/// @param nblocks maximum number of blocks to verify
+/// @param[out] nfree number of free blocks encountered (may be NULL)
+/// @param[out] free_bytes total size of free blocks encountered (may be NULL)
+/// @retval number of violated invariants
+static size_t verify_range(char *p, size_t nblocks, size_t *nfree, size_t *free_bytes)
+{
+  size_t errors = 0, n = 0, bytes = 0;
+
+  // a free predecessor must end with a footer that matches its header
+  if(!GET_PREV_ALLOC(p) && (p > (char*)arena->heap_start)) {
+    TYPE ftr = GET(PREV_PTR(p));
+    if((STATUS(ftr) != FREE) || (SIZE(ftr) == 0) || (SIZE(ftr) > (size_t)(p - (char*)arena->heap_start)) ||
+       (GET(p - SIZE(ftr)) != ftr)) {
+      LOG(1, "mm_verify: prev-alloc bit of %p does not match predecessor", p);
+      errors++;
+    }
+  }
+
+  while((p < (char*)arena->heap_end) && (nblocks-- > 0)) {
+    size_t size = GET_SIZE(p);
+    if((size == 0) || (size & (BS-1)) || (size > (size_t)((char*)arena->heap_end - p))) {
+      LOG(1, "mm_verify: invalid size 0x%lx of block %p", size, p);
+      errors++;
+      break;
+    }
+
+    errors += verify_block(p);
+    if(GET_STATUS(p) == FREE) {
+      n++;
+      bytes += size;
+    }
+
+    char *next = p + size;
+    if(!GET_PREV_ALLOC(next) != (GET_STATUS(p) == FREE)) {
+      LOG(1, "mm_verify: prev-alloc bit of %p does not match status of %p", next, p);
+      errors++;
+    }
+    p = next;
+  }
+
+  if(nfree) *nfree = n;
+  if(free_bytes) *free_bytes = bytes;
+  return errors;
+}
+
+/// @brief count the blocks in the free list(s) of the current arena and check that they are
+///        free heap blocks in the right list/order. Traversals are bounded by @a limit blocks.
+/// @param limit maximum number of blocks expected
+/// @retval number of free blocks found; (size_t)-1 if the free list(s) are corrupted
+static size_t verify_freelist(size_t limit)
+{
+  size_t n = 0;
+
+  switch(arena->freelist_policy) {
+    case fp_Explicit:
+      for(void *p = arena->free_head; p != NULL; p = NEXT_LIST_GET(p)) {
+        if(!in_heap(p) || (GET_STATUS(p) != FREE) || (n++ > limit)) return (size_t)-1;
+      }
+      break;
+
+    case fp_FirstFit:
+    case fp_NextFit:
+    case fp_BestFit:
+    case fp_GoodFit: {
+      void *last = NULL;
+      for(void *p = arena->free_head; p != NULL; last = p, p = NEXT_LIST_GET(p)) {
+        if(!in_heap(p) || (GET_STATUS(p) != FREE) || (p <= last) || (n++ > limit)) return (size_t)-1;
+      }
+      if((arena->rover != NULL) && (!in_heap(arena->rover) || (GET_STATUS(arena->rover) != FREE))) {
+        return (size_t)-1;
+      }
+      break;
+    }
+
+    case fp_TLSF:
+      for(int fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        if(!(arena->tlsf_fl_bitmap & (1UL << fl)) != (arena->tlsf_sl_bitmap[fl] == 0)) return (size_t)-1;
+
+        for(int sl = 0; sl < TLSF_SL_COUNT; sl++) {
+          void *p = arena->tlsf_heads[fl][sl];
+          if(!(arena->tlsf_sl_bitmap[fl] & (1U << sl)) != (p == NULL)) return (size_t)-1;
+
+          for(; p != NULL; p = NEXT_LIST_GET(p)) {
+            int f, s;
+            if(!in_heap(p) || (GET_STATUS(p) != FREE) || (n++ > limit)) return (size_t)-1;
+            tlsf_mapping(GET_SIZE(p), &f, &s);
+            if((f != fl) || (s != sl)) return (size_t)-1;
+          }
+        }
+      }
+      break;
+
+    case fp_SplayTree: {
+      // in-order traversal without a stack: the rightmost node of each left subtree is
+      // temporarily linked back to its in-order successor (Morris traversal)
+      void *t = arena->tree_root, *last = NULL;
+      size_t steps = 0;
+
+      while(t != NULL) {
+        if(!in_heap(t) || (GET_STATUS(t) != FREE) || (++steps > 4*limit + 4)) return (size_t)-1;
+
+        void *l = TREE_LEFT(t);
+        if(l != NULL) {
+          while((TREE_RIGHT(l) != NULL) && (TREE_RIGHT(l) != t)) {
+            if(!in_heap(l) || (++steps > 4*limit + 4)) return (size_t)-1;
+            l = TREE_RIGHT(l);
+          }
+          if(TREE_RIGHT(l) == NULL) {
+            TREE_SET_RIGHT(l, t);
+            t = TREE_LEFT(t);
+            continue;
+          }
+          TREE_SET_RIGHT(l, NULL);
+        }
+
+        if((last != NULL) && (tree_cmp(GET_SIZE(t), t, last) <= 0)) return (size_t)-1;
+        last = t;
+        n++;
+        t = TREE_RIGHT(t);
+      }
+      break;
+    }
+
+    case fp_Bitmap: {
+      // every run of set bits starts at a free block that lies above the low-water mark of its
+      // size; the summary matches the bitmap
+      size_t nwords = GRAN(arena->heap_end) / 64 + 1;
+      unsigned long carry = 0;
+      for(size_t w = 0; w < nwords; w++) {
+        unsigned long x = arena->gran_map[w];
+        if(!(arena->gran_sum[w / 64] & (1UL << (w % 64))) != (x == 0)) return (size_t)-1;
+
+        for(unsigned long starts = x & ~((x << 1) | carry); starts != 0; starts &= starts - 1) {
+          void *p = GRAN_PTR(w * 64 + __builtin_ctzl(starts));
+          if(!in_heap(p) || (GET_STATUS(p) != FREE) || (n++ > limit)) return (size_t)-1;
+          if(arena->gran_low[63 - __builtin_clzl(GET_SIZE(p) >> MM_GRANULE_LOG2)] > w) return (size_t)-1;
+        }
+        carry = x >> 63;
+      }
+      break;
+    }
+
+    default:
+      // implicit list: the heap walk is the free list
+      return limit;
+  }
+
+  return n;
+}
+
+/// @brief verify all invariants of the current arena
+/// @retval number of violated invariants
+static size_t arena_verify(void)
+{
+  size_t errors = 0;
+
+  // sentinels
+  if(GET(PREV_PTR(arena->heap_start)) != PACK(0, ALLOC)) {
+    LOG(1, "mm_verify: initial sentinel corrupted");
+    errors++;
+  }
+  if((GET_SIZE(arena->heap_end) != 0) || (GET_STATUS(arena->heap_end) != ALLOC)) {
+    LOG(1, "mm_verify: end sentinel corrupted");
+    return errors + 1;
+  }
+
+  // heap walk
+  size_t nfree, free_bytes;
+  errors += verify_range(arena->heap_start, SIZE_MAX, &nfree, &free_bytes);
+  if((nfree != arena->stats.free_blocks) || (free_bytes != arena->stats.free_bytes)) {
+    LOG(1, "mm_verify: heap walk found %lu free blocks (%lu bytes), statistics %lu (%lu bytes)",
+        nfree, free_bytes, arena->stats.free_blocks, arena->stats.free_bytes);
+    errors++;
+  }
+
+  // free list(s) against heap walk
+  if(verify_freelist(nfree) != nfree) {
+    LOG(1, "mm_verify: free list(s) do not match heap walk");
+    errors++;
+  }
+
+  // quick bins hold allocated blocks of their size
+  size_t quick_bytes = 0, limit = ((char*)arena->heap_end - (char*)arena->heap_start) / BS;
+  for(int i = 0; i < QUICK_BINS; i++) {
+    for(void *p = arena->quick_bins[i]; p != NULL; p = NEXT_LIST_GET(p)) {
+      if(!in_heap(p) || (GET_STATUS(p) != ALLOC) || (GET_SIZE(p) != (size_t)(i+1)*BS) ||
+         (limit-- == 0)) {
+        LOG(1, "mm_verify: quick bin %d corrupted", i);
+        errors++;
+        break;
+      }
+      quick_bytes += GET_SIZE(p);
+    }
+  }
+  if(quick_bytes != arena->quick_bytes) errors++;
+
+  return errors;
+}
+
+/// @brief block at which a verification window for an operation that returned @a ptr starts:
+///        the returned block or, for frees, the block the freed block ended up in (after
+///        coalescing). Frees that do not touch a heap block (slab objects) start at a block
+///        derived from the free structure.
+/// @param ptr payload pointer returned by the operation (NULL for frees)
+/// @param freed header of the block touched by a free (NULL: none)
+/// @retval void* pointer to header of block
+static void* verify_anchor(void *ptr, void *freed)
+{
+  if((ptr != NULL) && in_heap(PREV_PTR(ptr)) && !(GET(PREV_PTR(ptr)) & TAG)) return PREV_PTR(ptr);
+  if((ptr == NULL) && (freed != NULL) && in_heap(freed)) return freed;
+
+  switch(arena->freelist_policy) {
+    case fp_NextFit:
+      if(arena->rover != NULL) return arena->rover;
+      // fall through
+    case fp_Explicit:
+    case fp_FirstFit:
+    case fp_BestFit:
+    case fp_GoodFit:
+      if(arena->free_head != NULL) return arena->free_head;
+      break;
+
+    case fp_TLSF: {
+      // head of a pseudo-randomly selected non-empty first-level class
+      unsigned long fl_map = arena->tlsf_fl_bitmap;
+      if(fl_map == 0) break;
+      for(int k = arena->verify_ops % __builtin_popcountl(fl_map); k > 0; k--) fl_map &= fl_map - 1;
+      int fl = __builtin_ctzl(fl_map);
+      return arena->tlsf_heads[fl][__builtin_ctz(arena->tlsf_sl_bitmap[fl])];
+    }
+
+    case fp_SplayTree:
+      if(arena->tree_root != NULL) return arena->tree_root;
+      break;
+
+    default:
+      break;
+  }
+
+  return arena->heap_start;
+}
+
+/// @brief sampling mode: verify the current arena after every mm_verify_interval-th operation.
+///        Must be called with the arena locked, after the operation has completed.
+/// @param ptr payload pointer returned by the operation (NULL for frees)
+static inline void verify_sample(void *ptr)
+{
+  void *freed = arena->verify_freed;
+  arena->verify_freed = NULL;
+
+  if(!mm_verify_interval || (++arena->verify_ops % mm_verify_interval != 0)) return;
+
+  size_t errors;
+  if(mm_verify_window == 0) errors = arena_verify();
+  else errors = verify_range(verify_anchor(ptr, freed), mm_verify_window, NULL, NULL);
+
+  arena->stats.verify_samples++;
+  arena->stats.verify_errors += errors;
+}
+
+
+void* mm_malloc(size_t size)
+{
+  LOG(1, "mm_malloc(0x%lx (%lu))", size, size);
+  assert(mm_initialized);
+
+  // ignore spurious requests
+  if(size == 0) return NULL;
+
+  // large requests get their own mapping and do not need an arena
+  if(mm_mmap_thld && (size >= mm_mmap_thld)) return mmap_malloc(size);
+
+  void *ptr;
+
+  if(mm_narenas == 0) {
+    ptr = arena_malloc(size);
+    verify_sample(ptr);
+    return ptr;
+  }
+
+  // thread-safe mode: try the thread cache, then the home arena, then all other arenas
+  tcache_setup();
+
+  ptr = tcache_get(size);
+  if(ptr != NULL) return ptr;
+
+  for(int i = 0; (i < mm_narenas) && (ptr == NULL); i++) {
+    arena_lock(&arenas[(tcache.home + i) % mm_narenas]);
+    ptr = arena_malloc(size);
+    verify_sample(ptr);
+    pthread_mutex_unlock(&arena->lock);
+  }
+
+  return ptr;
+}
+
+
+void* mm_calloc(size_t nmemb, size_t size)
+{
+  LOG(1, "mm_calloc(0x%lx, 0x%lx (%lu))", nmemb, size, size);
+  assert(mm_initialized);
+
+  size_t bytes;
+  if(__builtin_mul_overflow(nmemb, size, &bytes)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  //
+  // calloc is simply malloc() followed by memset()
+  //
+  void *payload = mm_malloc(bytes);
+
+  if (payload != NULL) memset(payload, 0, bytes);
+
+  return payload;
+}
+
+
+void* mm_memalign(size_t alignment, size_t size)
+{
+  LOG(1, "mm_memalign(0x%lx, 0x%lx (%lu))", alignment, size, size);
+  assert(mm_initialized);
+
+  if((alignment == 0) || (alignment & (alignment-1))) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  // every payload is aligned to PAYLOAD_ALIGN
+  if(alignment <= PAYLOAD_ALIGN) return mm_malloc(size);
+
+  // ignore spurious requests
+  if(size == 0) return NULL;
+
+  void *ptr = NULL;
+
+  if(mm_narenas == 0) {
+    ptr = arena_memalign(alignment, size);
+    verify_sample(ptr);
+    return ptr;
+  }
+
+  // thread-safe mode: try the home arena, then all other arenas
+  tcache_setup();
+
+  for(int i = 0; (i < mm_narenas) && (ptr == NULL); i++) {
+    arena_lock(&arenas[(tcache.home + i) % mm_narenas]);
+    ptr = arena_memalign(alignment, size);
+    verify_sample(ptr);
+    pthread_mutex_unlock(&arena->lock);
+  }
+
+  return ptr;
+}
+
+
+void* mm_aligned_alloc(size_t alignment, size_t size)
+{
+  LOG(1, "mm_aligned_alloc(0x%lx, 0x%lx (%lu))", alignment, size, size);
+
+  return mm_memalign(alignment, size);
+}
+
+
+
+void* mm_realloc(void *ptr, size_t size)
+{
+  LOG(1, "mm_realloc(%p, 0x%lx (%lu))", ptr, size, size);
+  assert(mm_initialized);
+
+  if(ptr == NULL) return mm_malloc(size);
+  if(size == 0) { mm_free(ptr); return NULL; }
+
+  // mapped object: remap as long as it stays large, move it to the heap otherwise
+  if(IS_MMAPPED(ptr)) {
+    if(size >= mm_mmap_thld) return mmap_realloc(ptr, size);
+
+    size_t old_size = payload_size(ptr);
+
+    void *new_ptr = mm_malloc(size);
+    if(new_ptr) {
+      memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+      mmap_free(ptr);
+    }
+    return new_ptr;
+  }
+
+  void *new_ptr;
+
+  if(mm_narenas == 0) {
+    new_ptr = arena_realloc(ptr, size);
+    verify_sample(new_ptr);
+    return new_ptr;
+  }
+
+  // thread-safe mode: resize within the owning arena, move to another arena if it is full
+  arena_lock(arena_of(ptr));
+  new_ptr = arena_realloc(ptr, size);
+  verify_sample(new_ptr);
+  pthread_mutex_unlock(&arena->lock);
+
+  if(new_ptr == NULL) {
+    size_t old_size = payload_size(ptr);
+
+    new_ptr = mm_malloc(size);
+    if(new_ptr) {
+      memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+      mm_free(ptr);
+    }
+  }
+
+  return new_ptr;
+}
+
+
+void mm_free(void *ptr)
+{
+  LOG(1, "mm_free(%p)", ptr);
+  assert(mm_initialized);
+
+  if(ptr == NULL) return;
+
+  if(IS_MMAPPED(ptr)) {
+    mmap_free(ptr);
+    return;
+  }
+
+  if(mm_narenas == 0) {
+    arena_free(ptr);
+    verify_sample(NULL);
+    return;
+  }
+
+  // thread-safe mode: keep small blocks in the thread cache, otherwise free in the owning arena
+  tcache_setup();
+
+  // the header is read without holding the arena lock. Only the PREV_ALLOC bit of an allocated
+  // block's header can be modified concurrently (by the owner of its left neighbor)
+  TYPE header = __atomic_load_n((TYPE*)PREV_PTR(ptr), __ATOMIC_RELAXED);
+  if(!(header & TAG) && (header & ALLOC) && tcache_put(PREV_PTR(ptr), SIZE(header))) return;
+
+  // blocks of other arenas are handed to their owner without taking its lock
+  struct Arena *owner = arena_of(ptr);
+  if(owner != &arenas[tcache.home]) {
+    arena_remote_free(owner, ptr);
+    return;
+  }
+
+  arena_lock(owner);
+  arena_free(ptr);
+  verify_sample(NULL);
+  pthread_mutex_unlock(&arena->lock);
+}
+
+
+size_t mm_usable_size(void *ptr)
+{
+  LOG(1, "mm_usable_size(%p)", ptr);
+  assert(mm_initialized);
+
+  if(ptr == NULL) return 0;
+
+  // the size bits of an allocated block's header do not change while the block is allocated, so
+  // no lock is needed in thread-safe mode
+  return payload_size(ptr);
+}
+
+
+size_t mm_malloc_batch(size_t size, size_t n, void **ptrs)
+{
+  LOG(1, "mm_malloc_batch(0x%lx (%lu), %lu)", size, size, n);
+  assert(mm_initialized);
+
+  // ignore spurious requests
+  if((size == 0) || (n == 0)) return 0;
+
+  if(mm_narenas == 0) {
+    size_t cnt = arena_malloc_batch(size, n, ptrs);
+    verify_sample(NULL);
+    return cnt;
+  }
+
+  // thread-safe mode: start in the home arena, continue in the other arenas if it is full
+  tcache_setup();
+
+  size_t cnt = 0;
+  for(int i = 0; (i < mm_narenas) && (cnt < n); i++) {
+    arena_lock(&arenas[(tcache.home + i) % mm_narenas]);
+    cnt += arena_malloc_batch(size, n - cnt, &ptrs[cnt]);
+    verify_sample(NULL);
+    pthread_mutex_unlock(&arena->lock);
+  }
+
+  return cnt;
+}
+
+
+/// @brief qsort() comparison function ordering pointers by address
+static int ptr_cmp(const void *a, const void *b)
+{
+  char *pa = *(char**)a, *pb = *(char**)b;
+  return (pa > pb) - (pa < pb);
+}
+
+
+void mm_free_batch(void **ptrs, size_t n)
+{
+  LOG(1, "mm_free_batch(%p, %lu)", ptrs, n);
   assert(mm_initialized);
 
-  if(ptr == NULL) return mm_malloc(size);
-  if(size == 0) { mm_free(ptr); return NULL; }
-  // payload pointer -> block pointer
-  ptr = PREV_PTR(ptr);
-  if(GET_STATUS(ptr) == 0) {
-    printf("realloc() of free block");
-    return NULL;
+  // mapped objects are released individually
+  for(size_t i = 0; i < n; i++) {
+    if((ptrs[i] != NULL) && IS_MMAPPED(ptrs[i])) {
+      mmap_free(ptrs[i]);
+      ptrs[i] = NULL;
+    }
   }
 
-  size_t old_size = GET_SIZE(ptr);
-  size_t new_size = (size + TYPE_SIZE*2 + BS - 1) / BS * BS;
+  // sort by address. NULL pointers end up at the beginning and are skipped
+  qsort(ptrs, n, sizeof(void*), ptr_cmp);
 
-  if(old_size == new_size) return NEXT_PTR(ptr);
+  size_t i = 0;
+  while((i < n) && (ptrs[i] == NULL)) i++;
 
-  if(old_size > new_size) { // if the block is large enough, split it
-    PUT(ptr, PACK(new_size, 1));
-    PUT(HDR2FTR(ptr), PACK(new_size, 1));
+  if(mm_narenas == 0) {
+    arena_free_batch(&ptrs[i], n - i);
+    verify_sample(NULL);
+    return;
+  }
 
-    size_t split_size = old_size - new_size;
-    void *split_ptr = NEXT_BLKP(ptr);
-    PUT(split_ptr, PACK(split_size, 0));
-    PUT(HDR2FTR(split_ptr), PACK(split_size, 0));
+  // thread-safe mode: arenas occupy consecutive slices, so the sorted pointers of one arena
+  // form a contiguous range that is freed under a single lock
+  while(i < n) {
+    struct Arena *owner = arena_of(ptrs[i]);
+    size_t j = i + 1;
+    while((j < n) && (arena_of(ptrs[j]) == owner)) j++;
 
-    if(freelist_policy == fp_Explicit) add_free_block(split_ptr);
-    return NEXT_PTR(ptr);
+    arena_lock(owner);
+    arena_free_batch(&ptrs[i], j - i);
+    verify_sample(NULL);
+    pthread_mutex_unlock(&arena->lock);
+
+    i = j;
   }
+}
 
-  void* next_ptr = NEXT_BLKP(ptr);
-  size_t next_size = GET_SIZE(next_ptr);
-  // if there exists successor free block and the sum of the two blocks is large enough
-  if(GET_STATUS(next_ptr)==0 && old_size+next_size >= new_size) {
-    // remove the next block from the free list and merge the two blocks
-    if(freelist_policy == fp_Explicit) remove_free_block(next_ptr);
-    PUT(ptr, PACK(new_size, 1));
-    PUT(HDR2FTR(ptr), PACK(new_size, 1));
 
-    // possibly split the remainder and add to the free list
-    size_t split_size = old_size + next_size - new_size;
-    void *split_ptr = NEXT_BLKP(ptr);
-    if(split_size > 0) {
-      PUT(split_ptr, PACK(split_size, 0));
-      PUT(HDR2FTR(split_ptr), PACK(split_size, 0));
+void mm_setloglevel(int level)
+{
+  mm_loglevel = level;
+}
 
-      if(freelist_policy == fp_Explicit) add_free_block(split_ptr);
-    }
-    return NEXT_PTR(ptr);
+
+void mm_setfooter(int active)
+{
+  mm_footers = (active > 0);
+}
+
+
+void mm_setslab(int active)
+{
+  mm_slab = (active > 0);
+}
+
+
+void mm_setmmap(size_t threshold)
+{
+  mm_mmap_thld = threshold;
+}
+
+
+void mm_setgrowth(size_t min, size_t max)
+{
+  if (min > 0) mm_grow_min = min;
+  if (max > 0) mm_grow_max = max;
+}
+
+
+void mm_settrim(size_t threshold, size_t pad, unsigned long delay)
+{
+  mm_trim_thld = threshold;
+  mm_trim_pad = pad < threshold ? pad : threshold;
+  mm_trim_delay = delay;
+}
+
+
+void mm_setquickbins(int active)
+{
+  mm_quick = (active > 0);
+}
+
+
+void mm_setarenas(int n)
+{
+  mm_narenas = n < 0 ? 0 : n > MAX_ARENAS ? MAX_ARENAS : n;
+}
+
+
+void mm_setgoodfit(unsigned int tolerance)
+{
+  mm_goodfit_tol = tolerance;
+}
+
+
+void mm_setverify(unsigned long interval, size_t window)
+{
+  mm_verify_interval = interval;
+  mm_verify_window = window;
+}
+
+
+/// @brief add the statistics of arena @a a to @a stats
+/// @param a arena
+/// @param[in,out] stats statistics
+static void arena_stats(struct Arena *a, struct mm_stats *stats)
+{
+  stats->heap_size   += (char*)a->ds_heap_brk - (char*)a->ds_heap_start;
+  stats->heap_peak   += a->heap_peak;
+  stats->alloc_bytes += (char*)a->heap_end - (char*)a->heap_start - a->stats.free_bytes;
+  stats->free_bytes  += a->stats.free_bytes;
+  stats->free_blocks += a->stats.free_blocks;
+  for (int b = 0; b < MM_STATS_BINS; b++) stats->free_hist[b] += a->stats.free_hist[b];
+  stats->searches    += a->stats.searches;
+  stats->search_len  += a->stats.search_len;
+  stats->splits      += a->stats.splits;
+  stats->coalesces   += a->stats.coalesces;
+  stats->sbrk_calls  += a->stats.sbrk_calls;
+  stats->slab_hits   += a->stats.slab_hits;
+  stats->slab_misses += a->stats.slab_misses;
+  stats->verify_samples += a->stats.verify_samples;
+  stats->verify_errors += a->stats.verify_errors;
+}
+
+
+void mm_stats(struct mm_stats *stats)
+{
+  assert(mm_initialized);
+
+  memset(stats, 0, sizeof(*stats));
+
+  for (int i = 0; i < MAX(mm_narenas, 1); i++) {
+    struct Arena *a = &arenas[i];
+    if (mm_narenas > 0) pthread_mutex_lock(&a->lock);
+    arena_stats(a, stats);
+    if (mm_narenas > 0) pthread_mutex_unlock(&a->lock);
   }
 
-  void *new_ptr = mm_malloc(size);
-  if(new_ptr) {
-    memcpy(new_ptr, NEXT_PTR(ptr), old_size - TYPE_SIZE*2);
-    mm_free(NEXT_PTR(ptr));
+  ds_mmap_stat(&stats->mmap_objects, &stats->mmap_bytes);
+}
+
+
+void mm_slabstat(size_t *hits, size_t *misses)
+{
+  size_t h = 0, m = 0;
+
+  for (int i = 0; i < MAX(mm_narenas, 1); i++) {
+    h += arenas[i].stats.slab_hits;
+    m += arenas[i].stats.slab_misses;
   }
-  return new_ptr;
+
+  if (hits)   *hits = h;
+  if (misses) *misses = m;
 }
 
 
-void mm_free(void *ptr)
+size_t mm_verify(void)
 {
-  LOG(1, "mm_free(%p)", ptr);
   assert(mm_initialized);
 
+  if(mm_narenas == 0) return arena_verify();
+
+  struct Arena *current = arena;
+  size_t errors = 0;
+
+  for(int i = 0; i < mm_narenas; i++) {
+    arena_lock(&arenas[i]);
+    errors += arena_verify();
+    pthread_mutex_unlock(&arena->lock);
+  }
+  arena = current;
+
+  return errors;
+}
+
+
+/// @brief heap created by mm_heap_create(). The descriptor occupies the first page(s) of the
+///        heap's mapping, the arena's data segment follows it.
+struct mm_heap {
+  struct Arena arena;                                  ///< arena managing the heap
+  size_t map_size;                                     ///< size of the mapping in bytes
+  mm_heap_t prev, next;                                ///< list of all heaps (fork handlers)
+};
+static mm_heap_t heap_list = NULL;                     ///< all heaps created by mm_heap_create()
+static pthread_mutex_t heap_list_lock = PTHREAD_MUTEX_INITIALIZER; ///< protects heap_list
+
+/// @brief make the arena of @a heap the current arena and lock it
+/// @param heap heap handle
+/// @retval previous current arena, to be restored with heap_leave()
+static struct Arena* heap_enter(mm_heap_t heap)
+{
+  assert(heap != NULL);
+
+  struct Arena *current = arena;
+  arena_lock(&heap->arena);
+  return current;
+}
+
+/// @brief unlock the current (heap) arena and restore the previous current arena
+/// @param current arena returned by heap_enter()
+static void heap_leave(struct Arena *current)
+{
+  pthread_mutex_unlock(&arena->lock);
+  arena = current;
+}
+
+/// @brief fork() prepare handler: acquire all locks so that no arena is in an inconsistent state
+///        while the address space is copied
+static void fork_prepare(void)
+{
+  pthread_mutex_lock(&heap_list_lock);
+  for(mm_heap_t h = heap_list; h != NULL; h = h->next) pthread_mutex_lock(&h->arena.lock);
+  for(int i = 0; i < mm_narenas; i++) pthread_mutex_lock(&arenas[i].lock);
+}
+
+/// @brief fork() parent handler: release the locks acquired by fork_prepare()
+static void fork_parent(void)
+{
+  for(int i = mm_narenas-1; i >= 0; i--) pthread_mutex_unlock(&arenas[i].lock);
+  for(mm_heap_t h = heap_list; h != NULL; h = h->next) pthread_mutex_unlock(&h->arena.lock);
+  pthread_mutex_unlock(&heap_list_lock);
+}
+
+/// @brief fork() child handler: the child only has the forking thread, so the locks are
+///        reinitialized rather than unlocked. Blocks in the thread caches of the other threads
+///        remain allocated.
+static void fork_child(void)
+{
+  for(int i = 0; i < mm_narenas; i++) pthread_mutex_init(&arenas[i].lock, NULL);
+  for(mm_heap_t h = heap_list; h != NULL; h = h->next) pthread_mutex_init(&h->arena.lock, NULL);
+  pthread_mutex_init(&heap_list_lock, NULL);
+}
+
+/// @brief register the fork handlers
+static void fork_init(void)
+{
+  if(pthread_atfork(fork_prepare, fork_parent, fork_child) != 0) {
+    PANIC("Cannot register fork handlers.");
+  }
+}
+
+
+mm_heap_t mm_heap_create(FreelistPolicy fp, size_t size)
+{
+  LOG(1, "mm_heap_create(%d, 0x%lx (%lu))", fp, size, size);
+
+  if(PAGESIZE == 0) PAGESIZE = sysconf(_SC_PAGESIZE);
+
+  // the data segment must hold the initial heap; round both parts of the mapping to pages
+  size_t hdr_size = (sizeof(struct mm_heap) + PAGESIZE-1) & ~((size_t)PAGESIZE-1);
+  size = MAX(size, mm_grow_min + PAGESIZE);
+  if(size > SIZE_MAX - hdr_size - PAGESIZE) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  size = (size + PAGESIZE-1) & ~((size_t)PAGESIZE-1);
+#if MM_TAG_SIZE == 4
+  if(size > UINT32_MAX) {
+    errno = EINVAL;
+    return NULL;
+  }
+#endif
+
+  // one mapping for descriptor and data segment. Pages are only touched as the heap grows
+  void *map = mmap(NULL, hdr_size + size, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+  if(map == MAP_FAILED) return NULL;
+
+  mm_heap_t heap = map;
+  heap->map_size = hdr_size + size;
+
+  // the arena manages the data segment like a slice in thread-safe mode
+  struct Arena *current = arena;
+  arena = &heap->arena;
+  arena->ds_heap_start = arena->ds_heap_brk = (char*)map + hdr_size;
+  arena->ds_heap_limit = (char*)arena->ds_heap_start + size;
+  arena->link_base = arena->ds_heap_start;
+  arena->handle = 1;
+  arena_init(fp);
+  arena = current;
+
+  pthread_once(&fork_once, fork_init);
+  pthread_mutex_lock(&heap_list_lock);
+  heap->prev = NULL;
+  heap->next = heap_list;
+  if(heap_list != NULL) heap_list->prev = heap;
+  heap_list = heap;
+  pthread_mutex_unlock(&heap_list_lock);
+
+  return heap;
+}
+
+
+void mm_heap_destroy(mm_heap_t heap)
+{
+  LOG(1, "mm_heap_destroy(%p)", heap);
+
+  if(heap == NULL) return;
+
+  pthread_mutex_lock(&heap_list_lock);
+  if(heap->prev != NULL) heap->prev->next = heap->next;
+  else heap_list = heap->next;
+  if(heap->next != NULL) heap->next->prev = heap->prev;
+  pthread_mutex_unlock(&heap_list_lock);
+
+  // all blocks live in the heap's mapping; only the granule bitmap is mapped separately
+  if(heap->arena.gran_map != NULL) munmap(heap->arena.gran_map, heap->arena.gran_bytes);
+  pthread_mutex_destroy(&heap->arena.lock);
+  munmap(heap, heap->map_size);
+}
+
+
+void* mm_heap_malloc(mm_heap_t heap, size_t size)
+{
+  LOG(1, "mm_heap_malloc(%p, 0x%lx (%lu))", heap, size, size);
+
+  // ignore spurious requests
+  if(size == 0) return NULL;
+
+  struct Arena *current = heap_enter(heap);
+  void *ptr = arena_malloc(size);
+  verify_sample(ptr);
+  heap_leave(current);
+
+  return ptr;
+}
+
+
+void* mm_heap_calloc(mm_heap_t heap, size_t nmemb, size_t size)
+{
+  LOG(1, "mm_heap_calloc(%p, 0x%lx, 0x%lx (%lu))", heap, nmemb, size, size);
+
+  size_t bytes;
+  if(__builtin_mul_overflow(nmemb, size, &bytes)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  void *payload = mm_heap_malloc(heap, bytes);
+
+  if (payload != NULL) memset(payload, 0, bytes);
+
+  return payload;
+}
+
+
+void* mm_heap_memalign(mm_heap_t heap, size_t alignment, size_t size)
+{
+  LOG(1, "mm_heap_memalign(%p, 0x%lx, 0x%lx (%lu))", heap, alignment, size, size);
+
+  if((alignment == 0) || (alignment & (alignment-1))) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  // every payload is aligned to PAYLOAD_ALIGN
+  if(alignment <= PAYLOAD_ALIGN) return mm_heap_malloc(heap, size);
+
+  // ignore spurious requests
+  if(size == 0) return NULL;
+
+  struct Arena *current = heap_enter(heap);
+  void *ptr = arena_memalign(alignment, size);
+  verify_sample(ptr);
+  heap_leave(current);
+
+  return ptr;
+}
+
+
+void* mm_heap_realloc(mm_heap_t heap, void *ptr, size_t size)
+{
+  LOG(1, "mm_heap_realloc(%p, %p, 0x%lx (%lu))", heap, ptr, size, size);
+
+  if(ptr == NULL) return mm_heap_malloc(heap, size);
+  if(size == 0) { mm_heap_free(heap, ptr); return NULL; }
+
+  struct Arena *current = heap_enter(heap);
+  void *new_ptr = arena_realloc(ptr, size);
+  verify_sample(new_ptr);
+  heap_leave(current);
+
+  return new_ptr;
+}
+
+
+void mm_heap_free(mm_heap_t heap, void *ptr)
+{
+  LOG(1, "mm_heap_free(%p, %p)", heap, ptr);
+
   if(ptr == NULL) return;
-  ptr = PREV_PTR(ptr);
-  if(GET_STATUS(ptr) == 0) {
-    printf("double free error!");
-    return;
+
+  struct Arena *current = heap_enter(heap);
+  arena_free(ptr);
+  verify_sample(NULL);
+  heap_leave(current);
+}
+
+
+void mm_heap_stats(mm_heap_t heap, struct mm_stats *stats)
+{
+  assert(heap != NULL);
+
+  memset(stats, 0, sizeof(*stats));
+
+  pthread_mutex_lock(&heap->arena.lock);
+  arena_stats(&heap->arena, stats);
+  pthread_mutex_unlock(&heap->arena.lock);
+}
+
+
+size_t mm_heap_verify(mm_heap_t heap)
+{
+  struct Arena *current = heap_enter(heap);
+  size_t errors = arena_verify();
+  heap_leave(current);
+
+  return errors;
+}
+
+
+/// @brief additional chunk of a region, obtained with mm_malloc()
+struct RegionChunk {
+  struct RegionChunk *next;                            ///< next (older) chunk
+};
+
+/// @brief region created by mm_region_create(). The descriptor is stored at the beginning of
+///        the region's initial chunk; the rest of the chunk is the first bump area.
+struct mm_region {
+  struct RegionChunk *chunks;                          ///< additional chunks, most recent first
+  char *cur;                                           ///< next free byte of the current chunk
+  char *end;                                           ///< end of the current chunk
+  size_t chunk_size;                                   ///< size of a chunk in bytes
+};
+
+
+mm_region_t mm_region_create(size_t chunk_size)
+{
+  LOG(1, "mm_region_create(0x%lx (%lu))", chunk_size, chunk_size);
+
+  if(chunk_size == 0) chunk_size = REGION_CHUNK;
+  chunk_size = MAX(chunk_size, 4*sizeof(struct mm_region));
+
+  mm_region_t region = mm_malloc(chunk_size);
+  if(region == NULL) return NULL;
+
+  region->chunks = NULL;
+  region->cur = (char*)(region + 1);
+  region->end = (char*)region + chunk_size;
+  region->chunk_size = chunk_size;
+
+  return region;
+}
+
+
+void* mm_region_alloc(mm_region_t region, size_t size)
+{
+  // ignore spurious requests
+  if(size == 0) return NULL;
+
+  // bump the pointer of the current chunk
+  char *ptr = (char*)(((uintptr_t)region->cur + REGION_ALIGN-1) & ~(uintptr_t)(REGION_ALIGN-1));
+  if((ptr <= region->end) && (size <= (size_t)(region->end - ptr))) {
+    region->cur = ptr + size;
+    return ptr;
   }
-  
-  // update header and footer's status bits
-  size_t size = GET_SIZE(ptr);
-  PUT(ptr, PACK(size, 0));
-  PUT(HDR2FTR(ptr), PACK(size, 0));
 
-  // coalesce the block, shrinks heap if needed
-  coalesce(ptr, 1);
+  LOG(1, "mm_region_alloc(%p, 0x%lx (%lu)): new chunk", region, size, size);
+
+  if(size > SIZE_MAX - sizeof(struct RegionChunk) - REGION_ALIGN) return NULL;
+
+  // requests larger than a quarter chunk get a chunk of their own, so that the space left in the
+  // current chunk is not wasted
+  size_t hdr_size = sizeof(struct RegionChunk) + REGION_ALIGN-1;
+  int own = (size > region->chunk_size / 4);
+  size_t chunk_size = own ? hdr_size + size : MAX(region->chunk_size, hdr_size + size);
+
+  struct RegionChunk *chunk = mm_malloc(chunk_size);
+  if(chunk == NULL) return NULL;
+
+  chunk->next = region->chunks;
+  region->chunks = chunk;
+
+  ptr = (char*)(((uintptr_t)(chunk + 1) + REGION_ALIGN-1) & ~(uintptr_t)(REGION_ALIGN-1));
+  if(!own) {
+    region->cur = ptr + size;
+    region->end = (char*)chunk + chunk_size;
+  }
+
+  return ptr;
 }
 
 
-void mm_setloglevel(int level)
+void mm_region_reset(mm_region_t region)
 {
-  mm_loglevel = level;
+  LOG(1, "mm_region_reset(%p)", region);
+
+  // return the additional chunks to the heap in batches; adjacent chunks are coalesced at once
+  void *batch[REGION_BATCH];
+  size_t n = 0;
+
+  struct RegionChunk *chunk = region->chunks;
+  while(chunk != NULL) {
+    batch[n++] = chunk;
+    chunk = chunk->next;
+
+    if((n == REGION_BATCH) || (chunk == NULL)) {
+      mm_free_batch(batch, n);
+      n = 0;
+    }
+  }
+
+  // rewind to the initial chunk
+  region->chunks = NULL;
+  region->cur = (char*)(region + 1);
+  region->end = (char*)region + region->chunk_size;
 }
 
 
-void mm_check(void)
+void mm_region_destroy(mm_region_t region)
 {
-  assert(mm_initialized);
+  LOG(1, "mm_region_destroy(%p)", region);
+
+  if(region == NULL) return;
 
+  mm_region_reset(region);
+  mm_free(region);
+}
+
+
+/// @brief dump heap of the current arena and perform some sanity checks
+static void arena_check(void)
+{
   void *p;
 
   char *fpstr;
-  if (freelist_policy == fp_Implicit) fpstr = "Implicit";
-  else if (freelist_policy == fp_Explicit) fpstr = "Explicit";
+  if (arena->freelist_policy == fp_Implicit) fpstr = "Implicit";
+  else if (arena->freelist_policy == fp_Explicit) fpstr = "Explicit";
+  else if (arena->freelist_policy == fp_FirstFit) fpstr = "Address-ordered, first fit";
+  else if (arena->freelist_policy == fp_NextFit) fpstr = "Address-ordered, next fit";
+  else if (arena->freelist_policy == fp_BestFit) fpstr = "Address-ordered, best fit";
+  else if (arena->freelist_policy == fp_GoodFit) fpstr = "Address-ordered, good fit";
+  else if (arena->freelist_policy == fp_TLSF) fpstr = "TLSF";
+  else if (arena->freelist_policy == fp_SplayTree) fpstr = "Splay tree";
+  else if (arena->freelist_policy == fp_Bitmap) fpstr = "Granule bitmap";
   else fpstr = "invalid";
 
   printf("----------------------------------------- mm_check ----------------------------------------------\n");
-  printf("  ds_heap_start:          %p\n", ds_heap_start);
-  printf("  ds_heap_brk:            %p\n", ds_heap_brk);
-  printf("  heap_start:             %p\n", heap_start);
-  printf("  heap_end:               %p\n", heap_end);
+  printf("  ds_heap_start:          %p\n", arena->ds_heap_start);
+  printf("  ds_heap_brk:            %p\n", arena->ds_heap_brk);
+  printf("  heap_start:             %p\n", arena->heap_start);
+  printf("  heap_end:               %p\n", arena->heap_end);
   printf("  free list policy:       %s\n", fpstr);
+  printf("  allocated footers:      %s\n", arena->footers ? "yes" : "no");
+  printf("  slab front-end:         %s\n", arena->slab ? "on" : "off");
+  if (arena->slab) printf("  slab hits/misses:       %lu/%lu\n", arena->stats.slab_hits, arena->stats.slab_misses);
+  printf("  quick bins:             %s\n", arena->quick ? "on" : "off");
+  if (mm_mmap_thld) {
+    size_t nmaps, mapped;
+    ds_mmap_stat(&nmaps, &mapped);
+    printf("  mmap threshold:         %lu\n", mm_mmap_thld);
+    printf("  mmapped objects:        %lu (%lu bytes)\n", nmaps, mapped);
+  } else {
+    printf("  mmap threshold:         off\n");
+  }
+  if (arena->quick) printf("  quick bins size:        %lu\n", arena->quick_bytes);
 
   printf("\n");
-  p = PREV_PTR(heap_start);
+  p = PREV_PTR(arena->heap_start);
   printf("  initial sentinel:       %p: size: %6lx (%7ld), status: %s\n",
          p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
-  p = heap_end;
+  p = arena->heap_end;
   printf("  end sentinel:           %p: size: %6lx (%7ld), status: %s\n",
          p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
   printf("\n");
 
-  if(freelist_policy == fp_Implicit){
+  if((arena->freelist_policy == fp_Implicit) || (arena->freelist_policy == fp_Bitmap)){
     printf("    %-14s  %8s  %10s  %10s  %8s  %s\n", "address", "offset", "size (hex)", "size (dec)", "payload", "status");
   }
-  else if(freelist_policy == fp_Explicit){
-    printf("    %-14s  %8s  %10s  %10s  %8s  %-14s  %-14s  %s\n", "address", "offset", "size (hex)", "size (dec)", "payload", "next", "prev", "status");
+  else {
+    printf("    %-14s  %8s  %10s  %10s  %8s  %-14s  %-14s  %s\n", "address", "offset", "size (hex)", "size (dec)", "payload",
+           arena->freelist_policy == fp_SplayTree ? "left" : "next",
+           arena->freelist_policy == fp_SplayTree ? "right" : "prev", "status");
   }
 
   long errors = 0;
-  p = heap_start;
-  while (p < heap_end) {
+  TYPE prev_status = ALLOC;
+  p = arena->heap_start;
+  while (p < arena->heap_end) {
     char *ofs_str, *size_str;
 
     TYPE hdr = GET(p);
-    TYPE size = SIZE(hdr);
+    size_t size = SIZE(hdr);
     TYPE status = STATUS(hdr);
 
     void *next = NEXT_LIST_GET(p);
     void *prev = PREV_LIST_GET(p);
 
-    if (asprintf(&ofs_str, "0x%lx", p-heap_start) < 0) ofs_str = NULL;
+    if (asprintf(&ofs_str, "0x%lx", p-arena->heap_start) < 0) ofs_str = NULL;
     if (asprintf(&size_str, "0x%lx", size) < 0) size_str = NULL;
 
-    if(freelist_policy == fp_Implicit){
+    if((arena->freelist_policy == fp_Implicit) || (arena->freelist_policy == fp_Bitmap)){
       printf("    %p  %8s  %10s  %10ld  %8ld  %s\n",
-                p, ofs_str, size_str, size, size-2*TYPE_SIZE, status == ALLOC ? "allocated" : "free");
+                p, ofs_str, size_str, size, size-ALLOC_OVERHEAD,
+                hdr & SLAB ? "slab run" : status == ALLOC ? "allocated" : "free");
     }
-    else if(freelist_policy == fp_Explicit){
+    else {
       printf("    %p  %8s  %10s  %10ld  %8ld  %-14p  %-14p  %s\n",
-                p, ofs_str, size_str, size, size-2*TYPE_SIZE,
+                p, ofs_str, size_str, size, size-ALLOC_OVERHEAD,
                 status == ALLOC ? NULL : next, status == ALLOC ? NULL : prev,
-                status == ALLOC ? "allocated" : "free");
+                hdr & SLAB ? "slab run" : status == ALLOC ? "allocated" : "free");
     }
     
     free(ofs_str);
     free(size_str);
 
-    void *fp = p + size - TYPE_SIZE;
-    TYPE ftr = GET(fp);
-    TYPE fsize = SIZE(ftr);
-    TYPE fstatus = STATUS(ftr);
-
-    if ((size != fsize) || (status != fstatus)) {
+    if ((hdr & PREV_ALLOC) != (prev_status == ALLOC ? PREV_ALLOC : 0)) {
       errors++;
-      printf("    --> ERROR: footer at %p with different properties: size: %lx, status: %lx\n", 
-             fp, fsize, fstatus);
-      mm_panic("mm_check");
+      printf("    --> ERROR: prev-alloc bit of %p does not match status of previous block\n", p);
+    }
+    prev_status = status;
+
+    // allocated blocks have no footer in the footerless layout
+    if ((status == FREE) || arena->footers) {
+      void *fp = p + size - TYPE_SIZE;
+      TYPE ftr = GET(fp);
+      size_t fsize = SIZE(ftr);
+      TYPE fstatus = STATUS(ftr);
+
+      if ((size != fsize) || (status != fstatus)) {
+        errors++;
+        printf("    --> ERROR: footer at %p with different properties: size: %lx, status: %lx\n", 
+               fp, fsize, (unsigned long)fstatus);
+        mm_panic("mm_check");
+      }
     }
 
     p = p + size;
@@ -715,9 +3832,31 @@ void mm_check(void)
     }
   }
 
+  if ((p == arena->heap_end) && (GET(p) & PREV_ALLOC) != (prev_status == ALLOC ? PREV_ALLOC : 0)) {
+    errors++;
+    printf("    --> ERROR: prev-alloc bit of end sentinel does not match status of last block\n");
+  }
+
   printf("\n");
-  if ((p == heap_end) && (errors == 0)) printf("  Block structure coherent.\n");
+  if ((p == arena->heap_end) && (errors == 0)) printf("  Block structure coherent.\n");
   printf("-------------------------------------------------------------------------------------------------\n");
 }
 
 
+void mm_check(void)
+{
+  assert(mm_initialized);
+
+  if (mm_narenas == 0) {
+    arena_check();
+    return;
+  }
+
+  for (int i = 0; i < mm_narenas; i++) {
+    printf("  arena %d of %d\n", i, mm_narenas);
+
+    arena_lock(&arenas[i]);
+    arena_check();
+    pthread_mutex_unlock(&arena->lock);
+  }
+}
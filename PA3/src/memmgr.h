@@ -42,6 +42,13 @@
 typedef enum {
   fp_Implicit,                    ///< Implicit list management
   fp_Explicit,                    ///< Explicit list management
+  fp_TLSF,                        ///< Two-level segregated fit (constant time)
+  fp_SplayTree,                   ///< Best fit with a (size, address)-ordered splay tree
+  fp_FirstFit,                    ///< Address-ordered explicit list, first fit
+  fp_NextFit,                     ///< Address-ordered explicit list, next fit (roving pointer)
+  fp_BestFit,                     ///< Address-ordered explicit list, best fit
+  fp_GoodFit,                     ///< Address-ordered explicit list, good fit (see mm_setgoodfit())
+  fp_Bitmap,                      ///< First fit with a bitmap of free granules
 } FreelistPolicy;
 
 /// @brief initialize heap. Must be called before any of the other functions can be used.
@@ -57,9 +64,24 @@ void* mm_malloc(size_t size);
 /// @param nelem number of elements
 /// @param size size of one element in bytes
 /// @retval void* pointer to first byte of zeroed memory on success
-/// @retval NULL if memory allocation failed
+/// @retval NULL if memory allocation failed or @a nelem * @a size overflows (errno = ENOMEM)
 void* mm_calloc(size_t nelem, size_t size);
 
+/// @brief allocate a block of memory of @a size bytes whose address is a multiple of @a alignment
+/// @param alignment alignment in bytes (power of two)
+/// @param size requested size in bytes
+/// @retval void* pointer to first byte of aligned memory on success
+/// @retval NULL if memory allocation failed or @a alignment is invalid (errno = EINVAL)
+void* mm_memalign(size_t alignment, size_t size);
+
+/// @brief allocate a block of memory of @a size bytes whose address is a multiple of @a alignment.
+///        Same as mm_memalign(); @a size need not be a multiple of @a alignment.
+/// @param alignment alignment in bytes (power of two)
+/// @param size requested size in bytes
+/// @retval void* pointer to first byte of aligned memory on success
+/// @retval NULL if memory allocation failed or @a alignment is invalid (errno = EINVAL)
+void* mm_aligned_alloc(size_t alignment, size_t size);
+
 /// @brief re-allocate a block of memory to change its size to @a size bytes.
 /// @param ptr previously allocated block or NULL
 /// @param size requested new size in bytes
@@ -68,14 +90,209 @@ void* mm_calloc(size_t nelem, size_t size);
 void* mm_realloc(void *ptr, size_t size);
 
 /// @brief free a previously allocated block of memory
-/// @param ptr pointer to allocated memory obtained by calling mm_malloc, mm_calloc, or mm_realloc
+/// @param ptr pointer to allocated memory obtained by calling mm_malloc, mm_calloc, mm_realloc,
+///            mm_memalign, or mm_aligned_alloc
 void mm_free(void *ptr);
 
+/// @brief allocate @a n blocks of memory of @a size bytes each with a single free-list search
+/// @param size requested size of each block in bytes
+/// @param n number of blocks
+/// @param[out] ptrs array of (at least) @a n elements receiving the pointers to the blocks
+/// @retval number of blocks allocated. Less than @a n if memory allocation failed, in which case
+///         only the first (return value) elements of @a ptrs are valid
+size_t mm_malloc_batch(size_t size, size_t n, void **ptrs);
+
+/// @brief free @a n previously allocated blocks of memory. Adjacent blocks are coalesced in one
+///        pass.
+/// @param ptrs array of pointers to allocated memory or NULL. The array is sorted in place
+/// @param n number of pointers
+void mm_free_batch(void **ptrs, size_t n);
+
+/// @brief usable size of a previously allocated block of memory
+/// @param ptr pointer to allocated memory or NULL
+/// @retval number of bytes that can be written at @a ptr (at least the requested size; 0 if @a ptr
+///         is NULL)
+size_t mm_usable_size(void *ptr);
+
 /// @brief set log level
 /// @brief level log level (0: no logging, 1: info; 2: verbose)
 void mm_setloglevel(int level);
 
+/// @brief turn footers on allocated blocks on/off. Must be called before mm_init().
+///        Heaps created by mm_heap_create() use the setting in effect when they are created.
+/// @param active (1: allocated blocks carry a footer (default), 0: only free blocks carry a footer)
+void mm_setfooter(int active);
+
+/// @brief turn the slab front-end for small requests on/off. Must be called before mm_init().
+///        Heaps created by mm_heap_create() use the setting in effect when they are created.
+/// @param active (1: requests of up to 256 bytes are served from slab runs, 0: off (default))
+void mm_setslab(int active);
+
+/// @brief set the threshold for large objects. Requests of @a threshold bytes or more are served
+///        from separate page-aligned mappings and resized with mremap(). Can be called at any time.
+/// @param threshold size in bytes (0: all requests are served from the heap (default))
+void mm_setmmap(size_t threshold);
+
+/// @brief set the heap growth policy. The heap is extended by at least @a min bytes; repeated
+///        extensions in short succession double the step up to @a max bytes. Can be called at
+///        any time; the new @a min applies to the initial heap size only if set before mm_init().
+/// @param min minimal heap extension in bytes (default: 64 KB; 0: unchanged)
+/// @param max maximal heap extension step in bytes (default: 4 MB; 0: unchanged)
+void mm_setgrowth(size_t min, size_t max);
+
+/// @brief set the heap trim policy. Can be called at any time.
+/// @param threshold trim the heap when the free tail exceeds @a threshold bytes (default: 128 KB,
+///                  (size_t)-1: never trim)
+/// @param pad free bytes left at the tail after trimming (default: 64 KB; at most @a threshold)
+/// @param delay do not trim within @a delay allocations/frees after the heap was extended
+///              (default: 256)
+void mm_settrim(size_t threshold, size_t pad, unsigned long delay);
+
+/// @brief turn deferred coalescing with quick bins on/off. Must be called before mm_init().
+///        Heaps created by mm_heap_create() use the setting in effect when they are created.
+/// @param active (1: freed blocks of up to 256 bytes are kept in LIFO quick bins and coalesced
+///               lazily, 0: blocks are coalesced immediately (default))
+void mm_setquickbins(int active);
+
+/// @brief set the tolerance of the good fit policy (fp_GoodFit). Can be called at any time.
+/// @param tolerance the first free block that exceeds the request by at most @a tolerance percent
+///                  is taken; if there is none, the best fit (default: 25; 0: best fit)
+void mm_setgoodfit(unsigned int tolerance);
+
+/// @brief select single-threaded or thread-safe mode. Must be called before mm_init().
+/// @param n number of arenas (0: single-threaded mode (default), n > 0: thread-safe mode with
+///          n arenas, each managing 1/n-th of the data segment)
+void mm_setarenas(int n);
+
+/// @brief turn the sampling heap verifier on/off. After every @a interval-th operation (malloc,
+///        calloc, realloc, free, or batch) on an arena, the arena is verified as in mm_verify().
+///        The number of samples and violations found are reported in struct mm_stats.
+/// @param interval number of operations between two samples (0: off (default))
+/// @param window number of blocks verified per sample (0: entire heap). Windows start at the
+///               block returned or freed by the sampled operation.
+void mm_setverify(unsigned long interval, size_t window);
+
+/// @brief number of bins in the free block size histogram of struct mm_stats
+#define MM_STATS_BINS 20
+
+/// @brief heap statistics. Counters are maintained incrementally by the allocator; retrieving
+///        them with mm_stats() does not walk the heap. In thread-safe mode, the values are sums
+///        over all arenas.
+struct mm_stats {
+  size_t heap_size;                    ///< current heap footprint (data segment in use) in bytes
+  size_t heap_peak;                    ///< peak heap footprint in bytes
+  size_t alloc_bytes;                  ///< bytes in allocated blocks (including boundary tags)
+  size_t free_bytes;                   ///< bytes in free blocks
+  size_t free_blocks;                  ///< number of free blocks
+  size_t free_hist[MM_STATS_BINS];     ///< free blocks by size: bin i counts blocks of
+                                       ///< [32*2^i, 32*2^(i+1)) bytes (16*2^i in the g16 build
+                                       ///< variant), the last bin all larger ones
+  size_t searches;                     ///< number of free block searches
+  size_t search_len;                   ///< free list entries (blocks/classes/tree nodes) inspected
+  size_t splits;                       ///< number of block splits
+  size_t coalesces;                    ///< number of merges of adjacent blocks
+  size_t sbrk_calls;                   ///< number of heap extensions and trims
+  size_t mmap_objects;                 ///< number of live mmapped large objects
+  size_t mmap_bytes;                   ///< total size of mmapped large objects
+  size_t slab_hits;                    ///< small requests served from an existing slab run
+  size_t slab_misses;                  ///< small requests that required a new slab run
+  size_t verify_samples;               ///< number of heap verifications in sampling mode
+  size_t verify_errors;                ///< invariant violations found in sampling mode
+};
+
+/// @brief retrieve heap statistics. External fragmentation can be computed from the free block
+///        histogram, e.g., as 1 - (largest free block / free_bytes); the average search length is
+///        search_len / searches.
+/// @param[out] stats statistics
+void mm_stats(struct mm_stats *stats);
+
+/// @brief retrieve slab front-end statistics. The hit rate is hits / (hits + misses).
+/// @param[out] hits   number of small requests served from an existing slab run
+/// @param[out] misses number of small requests that required carving a new slab run
+void mm_slabstat(size_t *hits, size_t *misses);
+
+/// @brief verify the heap silently in one pass. Checks that
+///        - the initial and end sentinels are intact,
+///        - every block has a sane size and its footer (if any) matches its header,
+///        - the prev-alloc bits match the status of the preceding blocks,
+///        - no two free blocks are adjacent, and
+///        - the free list(s) contain exactly the free blocks of the heap walk.
+/// @retval number of violated invariants (0: heap is consistent)
+size_t mm_verify(void);
+
 /// @brief dump heap and perform some sanity checks
 void mm_check(void);
 
+/// @brief handle of a heap created by mm_heap_create()
+typedef struct mm_heap *mm_heap_t;
+
+/// @brief create an isolated heap with its own free list policy and data segment. The heap is
+///        independent of mm_init() and of all other heaps. It shares the global settings
+///        (footers, slab front-end, quick bins, growth and trim policy, verifier) but never
+///        serves requests from separate mappings (mm_setmmap()). Operations on the same heap
+///        are serialized with a per-heap lock.
+/// @param fp free list policy
+/// @param size maximal size of the heap's data segment in bytes. Address space is reserved
+///             up-front, memory is only committed as the heap grows
+/// @retval mm_heap_t heap handle on success
+/// @retval NULL if the data segment cannot be reserved
+mm_heap_t mm_heap_create(FreelistPolicy fp, size_t size);
+
+/// @brief destroy @a heap and release all of its memory at once, including blocks that have not
+///        been freed. Runs in constant time.
+/// @param heap heap handle or NULL
+void mm_heap_destroy(mm_heap_t heap);
+
+/// @brief allocate a block of memory of @a size bytes in @a heap. See mm_malloc().
+void* mm_heap_malloc(mm_heap_t heap, size_t size);
+
+/// @brief allocate a block of memory of @a nelem * @a size bytes initialized with zeroes in
+///        @a heap. See mm_calloc().
+void* mm_heap_calloc(mm_heap_t heap, size_t nelem, size_t size);
+
+/// @brief allocate a block of memory of @a size bytes aligned to @a alignment in @a heap. See
+///        mm_memalign().
+void* mm_heap_memalign(mm_heap_t heap, size_t alignment, size_t size);
+
+/// @brief re-allocate block @a ptr of @a heap to @a size bytes. See mm_realloc().
+void* mm_heap_realloc(mm_heap_t heap, void *ptr, size_t size);
+
+/// @brief free block @a ptr allocated in @a heap. See mm_free().
+void mm_heap_free(mm_heap_t heap, void *ptr);
+
+/// @brief retrieve statistics of @a heap. See mm_stats(); mmap_objects/mmap_bytes are always 0.
+void mm_heap_stats(mm_heap_t heap, struct mm_stats *stats);
+
+/// @brief verify @a heap silently in one pass. See mm_verify().
+/// @retval number of violated invariants (0: heap is consistent)
+size_t mm_heap_verify(mm_heap_t heap);
+
+/// @brief handle of a region created by mm_region_create()
+typedef struct mm_region *mm_region_t;
+
+/// @brief create a region. A region is a bump-pointer allocator for objects with a common
+///        lifetime; its memory is obtained from the heap (mm_malloc()) in chunks and released
+///        all at once with mm_region_reset() or mm_region_destroy(). Individual objects cannot
+///        be freed. A region must not be used by several threads concurrently.
+/// @param chunk_size size of the chunks taken from the heap in bytes (0: 64 KB)
+/// @retval mm_region_t region handle on success
+/// @retval NULL if memory allocation failed
+mm_region_t mm_region_create(size_t chunk_size);
+
+/// @brief allocate @a size bytes from @a region. The memory is 16-byte aligned.
+/// @param region region handle
+/// @param size requested size in bytes
+/// @retval void* pointer to first byte of memory on success
+/// @retval NULL if memory allocation failed
+void* mm_region_alloc(mm_region_t region, size_t size);
+
+/// @brief release all objects of @a region. All chunks except the initial one are returned to the
+///        heap with mm_free_batch(); the region can be reused afterwards.
+/// @param region region handle
+void mm_region_reset(mm_region_t region);
+
+/// @brief release all objects of @a region and the region itself
+/// @param region region handle or NULL
+void mm_region_destroy(mm_region_t region);
+
 #endif // __MEMMGR_H__
@@ -0,0 +1,876 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                       Memory Lab                                   Spring 2024
+//
+/// @file
+/// @brief trace replayer and benchmark for the dynamic memory manager
+///
+/// @section license_section License
+/// Copyright (c) 2020-2023, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED  TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)   HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+//
+// Trace replayer
+// ==============
+// mm_bench replays .dmas scripts (the format read by mm_driver) against our memory manager, the
+// null implementation, and the C standard library and reports, for each script, implementation,
+// and free list policy
+//   - throughput in kops/sec (replay without instrumentation),
+//   - peak utilization: maximal live payload / maximal heap footprint,
+//   - latency percentiles per operation in nanoseconds (second, instrumented replay), and
+//   - start-up time (ds_allocate(), mm_init()) and resident size of the data segment.
+//
+// Supported script commands:
+//   dataseg <size>        size of the data segment
+//   heap <policy>         free list policy (overridden by --policy)
+//   m <id> <size>         malloc
+//   c <id> <size>         calloc
+//   r <id> <size>         realloc
+//   f <id>                free (f -1 frees NULL)
+//   mode <mode>           correctness or performance (default)
+//   stop                  end of the measured section; the rest of the script is ignored
+// All other commands (log, start, stat, v) are accepted and ignored.
+//
+// The script is parsed completely before it is replayed; in the measured replays, payloads are
+// not touched.
+//
+// Scripts in correctness mode (or all scripts with --check) are first replayed once more to
+// validate the allocator. Every block is filled with a pattern derived from its id, and the
+// pattern is verified when the block is freed or reallocated (up to the smaller size). calloc'ed
+// blocks must be zeroed. All live blocks are kept in a blocklist (blocklist.c), and each new block
+// is checked against its neighbors for overlap and against the heap bounds. Errors are reported
+// per run, and mm_bench exits with a non-zero status if any run had errors.
+//
+// With --threads <n>, n threads replay the script concurrently, each with its own set of blocks,
+// and only the aggregate throughput is reported. memmgr runs in thread-safe mode with one arena
+// per thread (--arenas overrides), and its data segment is n times the script's and reserved
+// lazily. Comparing the throughput for different n shows how the allocator scales with the
+// number of cores.
+//
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "blocklist.h"
+#include "dataseg.h"
+#include "memmgr.h"
+#include "nulldriver.h"
+
+
+/// @brief block id of 'f -1' (free(NULL))
+#define NULL_ID UINT32_MAX
+
+/// @brief number of free list policies (FreelistPolicy)
+#define NPOLICIES 9
+
+/// @brief a single operation of a script
+struct Op {
+  uint32_t id;                                        ///< block id
+  uint32_t size;                                      ///< size in bytes (m, c, r)
+  char type;                                          ///< 'm', 'c', 'r', or 'f'
+};
+
+/// @brief a parsed script
+struct Trace {
+  const char *name;                                   ///< file name
+  size_t dssize;                                      ///< data segment size
+  FreelistPolicy policy;                              ///< free list policy from script
+  struct Op *ops;                                     ///< operations
+  size_t nops;                                        ///< number of operations
+  uint32_t nids;                                      ///< largest block id + 1
+  int correctness;                                    ///< script is in correctness mode
+};
+
+/// @brief benchmark settings
+struct Settings {
+  size_t dssize;                                      ///< data segment size (0: from script)
+  int impl[3];                                        ///< implementations to run
+  int policy[NPOLICIES];                              ///< policies to run (none: from script)
+  int footer;                                         ///< mm_setfooter()
+  int slab;                                           ///< mm_setslab()
+  int quick;                                          ///< mm_setquickbins()
+  size_t mmap;                                        ///< mm_setmmap()
+  unsigned int goodfit;                               ///< mm_setgoodfit()
+  unsigned long verify;                               ///< mm_setverify() interval
+  int lazy;                                           ///< ds_setlazy()
+  int hugepages;                                      ///< ds_sethugepages()
+  size_t window;                                      ///< mm_setverify() window
+  int threads;                                        ///< number of replaying threads
+  int arenas;                                         ///< mm_setarenas() (threaded replay)
+  int check;                                          ///< validate all scripts (--check)
+};
+
+/// @brief an allocator implementation
+struct Impl {
+  const char *name;                                   ///< name
+  void (*init)(struct Settings*, struct Trace*, FreelistPolicy); ///< set up allocator
+  void (*fini)(void);                                 ///< tear down allocator
+  void* (*malloc)(size_t);                            ///< malloc()
+  void* (*calloc)(size_t, size_t);                    ///< calloc()
+  void* (*realloc)(void*, size_t);                    ///< realloc()
+  void (*free)(void*);                                ///< free()
+  size_t (*footprint)(void);                          ///< current heap footprint in bytes
+  size_t (*errors)(void);                             ///< heap errors found so far
+  size_t (*rss)(void);                                ///< resident size of the heap in bytes (0: n/a)
+  int (*inheap)(void*, size_t);                       ///< block lies inside the heap (NULL: no
+                                                      ///< validation)
+};
+
+static size_t total_errors = 0;                       ///< validation errors in all runs
+static size_t memmgr_mmap = 0;                        ///< large object threshold of memmgr
+
+static const char *policy_names[NPOLICIES] = {
+  "implicit", "explicit", "tlsf", "splay", "first", "next", "best", "good", "bitmap"
+};
+
+
+/// @brief print an error message and exit
+static void panic(const char *msg, const char *arg)
+{
+  fprintf(stderr, "ERROR: %s '%s'.\n", msg, arg);
+  exit(EXIT_FAILURE);
+}
+
+/// @brief allocate @a size bytes of zeroed memory for mm_bench's own bookkeeping
+///        Bypasses libc's malloc so that its footprint does not include the bookkeeping data.
+static void* bench_alloc(size_t size)
+{
+  void *p = mmap(NULL, size + 16, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) panic("Out of memory", "mmap");
+  *(size_t*)p = size + 16;
+  return (char*)p + 16;
+}
+
+/// @brief release memory allocated with bench_alloc()
+static void bench_free(void *p)
+{
+  if (p != NULL) munmap((char*)p - 16, *(size_t*)((char*)p - 16));
+}
+
+/// @brief parse a free list policy name
+/// @retval policy on success, -1 otherwise
+static int parse_policy(const char *name)
+{
+  if (strcmp(name, "splaytree") == 0) return fp_SplayTree;
+  for (int i = 0; i < NPOLICIES; i++) {
+    if (strcmp(name, policy_names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Implementations
+//
+
+static void memmgr_init(struct Settings *s, struct Trace *t, FreelistPolicy fp)
+{
+  size_t dssize = s->dssize ? s->dssize : t->dssize;
+  if (s->threads > 1) dssize *= s->threads;
+
+  ds_setlazy(s->lazy || (s->threads > 1));
+  ds_sethugepages(s->hugepages);
+  ds_allocate(dssize);
+  mm_setarenas(s->threads > 1 ? s->arenas : 0);
+  mm_setfooter(s->footer);
+  mm_setslab(s->slab);
+  mm_setquickbins(s->quick);
+  mm_setmmap(s->mmap);
+  memmgr_mmap = s->mmap;
+  mm_setgoodfit(s->goodfit);
+  mm_setverify(s->verify, s->window);
+  mm_init(fp);
+}
+
+static void memmgr_fini(void)
+{
+  ds_release();
+}
+
+static size_t memmgr_footprint(void)
+{
+  struct mm_stats stats;
+  mm_stats(&stats);
+  return stats.heap_size + stats.mmap_bytes;
+}
+
+static size_t memmgr_errors(void)
+{
+  struct mm_stats stats;
+  mm_stats(&stats);
+  return stats.verify_errors;
+}
+
+static size_t memmgr_rss(void)
+{
+  return ds_getrss();
+}
+
+static int memmgr_inheap(void *ptr, size_t size)
+{
+  char *start, *brk, *end, *p = ptr;
+  ds_heap_stat((void**)&start, (void**)&brk, (void**)&end);
+
+  if ((p >= start) && (p + size <= brk)) return 1;
+
+  // large objects live in their own mappings outside the data segment
+  return memmgr_mmap && (size >= memmgr_mmap) && ((p + size <= start) || (p >= end));
+}
+
+static void libc_init(struct Settings *s, struct Trace *t, FreelistPolicy fp)
+{
+}
+
+static void libc_fini(void)
+{
+  malloc_trim(0);
+}
+
+static size_t libc_footprint(void)
+{
+  struct mallinfo2 mi = mallinfo2();
+  return mi.arena + mi.hblkhd;
+}
+
+static void null_init(struct Settings *s, struct Trace *t, FreelistPolicy fp)
+{
+}
+
+static void null_fini(void)
+{
+}
+
+static size_t null_footprint(void)
+{
+  return 0;
+}
+
+static size_t no_errors(void)
+{
+  return 0;
+}
+
+static size_t no_rss(void)
+{
+  return 0;
+}
+
+static int any_inheap(void *ptr, size_t size)
+{
+  return 1;
+}
+
+static struct Impl impls[] = {
+  { "memmgr", memmgr_init, memmgr_fini, mm_malloc, mm_calloc, mm_realloc, mm_free, memmgr_footprint, memmgr_errors, memmgr_rss, memmgr_inheap },
+  { "libc",   libc_init,   libc_fini,   malloc,    calloc,    realloc,    free,    libc_footprint,   no_errors,     no_rss, any_inheap },
+  { "null",   null_init,   null_fini,   null_malloc, null_calloc, null_realloc, null_free, null_footprint, no_errors,   no_rss, NULL },
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// Script parsing
+//
+
+/// @brief read script @a fn
+/// @param fn file name
+/// @param[out] t parsed script
+static void read_trace(const char *fn, struct Trace *t)
+{
+  FILE *f = fopen(fn, "r");
+  if (f == NULL) panic("Cannot open script", fn);
+
+  memset(t, 0, sizeof(*t));
+  t->name = fn;
+  t->dssize = 0x4000000;
+  t->policy = fp_Implicit;
+
+  size_t cap = 1 << 16;
+  t->ops = bench_alloc(cap * sizeof(struct Op));
+
+  char *line = NULL;
+  size_t llen = 0;
+  while (getline(&line, &llen, f) > 0) {
+    char *p = line + strspn(line, " \t");
+    if ((*p == '#') || (*p == '\n') || (*p == '\0')) continue;
+
+    char cmd[16], arg[64];
+    int id;
+    unsigned long size;
+    struct Op op;
+
+    if ((sscanf(p, "%15s", cmd) != 1)) continue;
+
+    if (strcmp(cmd, "stop") == 0) break;
+
+    if (strcmp(cmd, "dataseg") == 0) {
+      if (sscanf(p, "%*s %63s", arg) != 1) panic("Invalid dataseg size in", fn);
+      t->dssize = strtoul(arg, NULL, 0);
+      continue;
+    } else if (strcmp(cmd, "heap") == 0) {
+      if ((sscanf(p, "%*s %63s", arg) != 1) || (parse_policy(arg) < 0)) panic("Invalid policy in", fn);
+      t->policy = parse_policy(arg);
+      continue;
+    } else if (strcmp(cmd, "mode") == 0) {
+      if (sscanf(p, "%*s %63s", arg) != 1) panic("Invalid mode in", fn);
+      t->correctness = (strcmp(arg, "correctness") == 0);
+      continue;
+    } else if (((cmd[0] == 'm') || (cmd[0] == 'c') || (cmd[0] == 'r')) && (cmd[1] == '\0')) {
+      if ((sscanf(p, "%*s %d %lu", &id, &size) != 2) || (id < 0)) panic("Invalid line", p);
+      op.size = size;
+    } else if ((cmd[0] == 'f') && (cmd[1] == '\0')) {
+      if (sscanf(p, "%*s %d", &id) != 1) panic("Invalid line", p);
+      op.size = 0;
+    } else {
+      continue;
+    }
+
+    op.id = (id < 0) ? NULL_ID : id;
+    op.type = cmd[0];
+    if ((op.id != NULL_ID) && (op.id >= t->nids)) t->nids = op.id + 1;
+
+    if (t->nops == cap) {
+      struct Op *ops = bench_alloc(2 * cap * sizeof(struct Op));
+      memcpy(ops, t->ops, cap * sizeof(struct Op));
+      bench_free(t->ops);
+      t->ops = ops;
+      cap *= 2;
+    }
+    t->ops[t->nops++] = op;
+  }
+
+  free(line);
+  fclose(f);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Replay
+//
+
+/// @brief execute operation @a op
+static inline void execute(struct Impl *impl, struct Op *op, void **ptr)
+{
+  switch (op->type) {
+    case 'm': ptr[op->id] = impl->malloc(op->size); break;
+    case 'c': ptr[op->id] = impl->calloc(1, op->size); break;
+    case 'r': {
+      void *p = impl->realloc(ptr[op->id], op->size);
+      if ((p != NULL) || (op->size == 0)) ptr[op->id] = p;
+      break;
+    }
+    case 'f':
+      if (op->id == NULL_ID) {
+        impl->free(NULL);
+      } else {
+        impl->free(ptr[op->id]);
+        ptr[op->id] = NULL;
+      }
+      break;
+  }
+}
+
+/// @brief free all blocks that are still allocated after a replay
+static void release_all(struct Impl *impl, struct Trace *t, void **ptr)
+{
+  for (uint32_t i = 0; i < t->nids; i++) {
+    if (ptr[i] != NULL) impl->free(ptr[i]);
+    ptr[i] = NULL;
+  }
+}
+
+/// @brief pattern byte at offset @a ofs of block @a id
+static inline uint8_t pattern(uint32_t id, size_t ofs)
+{
+  return (uint8_t)((id * 2654435761u >> 24) + ofs);
+}
+
+/// @brief check that the first @a size bytes of block @a id at @a p hold its pattern
+/// @retval 1 if the pattern is intact, 0 otherwise
+static int verify_pattern(uint32_t id, uint8_t *p, size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    if (p[i] != pattern(id, i)) return 0;
+  }
+  return 1;
+}
+
+/// @brief fill the first @a size bytes of block @a id at @a p with its pattern
+static void fill_pattern(uint32_t id, uint8_t *p, size_t size)
+{
+  for (size_t i = 0; i < size; i++) p[i] = pattern(id, i);
+}
+
+/// @brief print a validation error of operation @a i
+static void check_error(struct Trace *t, struct Impl *impl, size_t i, const char *msg)
+{
+  struct Op *op = &t->ops[i];
+  fprintf(stderr, "%s: %s: op %lu (%c %u %u): %s.\n", t->name, impl->name, i, op->type,
+          op->id, op->size, msg);
+}
+
+/// @brief register new block @a id in the blocklist and check it for overlap and heap bounds
+/// @retval number of errors
+static size_t check_block(struct Trace *t, struct Impl *impl, size_t i, void *ptr, size_t size)
+{
+  size_t errors = 0;
+
+  if (!impl->inheap(ptr, size)) {
+    check_error(t, impl, i, "block outside of heap");
+    errors++;
+  }
+
+  Block *b = insert_block(ptr, size, t->ops[i].id);
+  if (b == NULL) panic("Out of memory", "insert_block");
+
+  if ((b->prev->ptr != NULL) && ((char*)b->prev->ptr + b->prev->size > (char*)ptr)) {
+    check_error(t, impl, i, "block overlaps its predecessor");
+    errors++;
+  }
+  if ((b->next->ptr != (void*)-1) && ((char*)ptr + size > (char*)b->next->ptr)) {
+    check_error(t, impl, i, "block overlaps its successor");
+    errors++;
+  }
+
+  return errors;
+}
+
+/// @brief replay trace @a t on @a impl once and validate payloads and block placement
+/// @retval number of errors
+static size_t validate(struct Settings *s, struct Trace *t, struct Impl *impl, FreelistPolicy fp)
+{
+  void **ptr = bench_alloc(t->nids * sizeof(void*));
+  size_t *size = bench_alloc(t->nids * sizeof(size_t));
+  size_t errors = 0;
+
+  init_blocklist();
+  impl->init(s, t, fp);
+
+  for (size_t i = 0; i < t->nops; i++) {
+    struct Op *op = &t->ops[i];
+    uint32_t id = op->id;
+
+    if (id == NULL_ID) {
+      execute(impl, op, ptr);
+      continue;
+    }
+
+    // blocks are verified and unregistered before they are freed or reallocated
+    void *old = ptr[id];
+    size_t old_size = size[id];
+    if ((old != NULL) && ((op->type == 'f') || (op->type == 'r'))) {
+      if (!verify_pattern(id, old, old_size)) {
+        check_error(t, impl, i, "payload corrupted");
+        errors++;
+      }
+      delete_block(old);
+    }
+
+    void *p = NULL;
+    switch (op->type) {
+      case 'm':
+        p = impl->malloc(op->size);
+        break;
+
+      case 'c':
+        p = impl->calloc(1, op->size);
+        for (size_t j = 0; (p != NULL) && (j < op->size); j++) {
+          if (((uint8_t*)p)[j] != 0) {
+            check_error(t, impl, i, "calloc'ed block not zeroed");
+            errors++;
+            break;
+          }
+        }
+        break;
+
+      case 'r':
+        p = impl->realloc(old, op->size);
+        if ((p == NULL) && (op->size > 0)) {
+          // failed: the old block is still valid
+          if (old != NULL) errors += check_block(t, impl, i, old, old_size);
+          continue;
+        }
+        if ((p != NULL) && (old != NULL) &&
+            !verify_pattern(id, p, old_size < op->size ? old_size : op->size)) {
+          check_error(t, impl, i, "realloc did not preserve the payload");
+          errors++;
+        }
+        break;
+
+      case 'f':
+        impl->free(old);
+        break;
+    }
+
+    ptr[id] = p;
+    size[id] = 0;
+    if (p != NULL) {
+      size[id] = op->size;
+      fill_pattern(id, p, op->size);
+      errors += check_block(t, impl, i, p, op->size);
+    }
+  }
+
+  // live blocks must still hold their patterns at the end of the script
+  for (uint32_t id = 0; id < t->nids; id++) {
+    if ((ptr[id] != NULL) && !verify_pattern(id, ptr[id], size[id])) {
+      fprintf(stderr, "%s: %s: block %u corrupted at end of script.\n", t->name, impl->name, id);
+      errors++;
+    }
+  }
+
+  release_all(impl, t, ptr);
+  impl->fini();
+  free_blocklist();
+
+  bench_free(size);
+  bench_free(ptr);
+
+  return errors;
+}
+
+/// @brief time difference in nanoseconds
+static inline uint64_t elapsed(struct timespec *a, struct timespec *b)
+{
+  return (b->tv_sec - a->tv_sec) * 1000000000UL + b->tv_nsec - a->tv_nsec;
+}
+
+/// @brief check whether time @a a lies before time @a b
+static inline int ts_before(struct timespec *a, struct timespec *b)
+{
+  return (a->tv_sec < b->tv_sec) || ((a->tv_sec == b->tv_sec) && (a->tv_nsec < b->tv_nsec));
+}
+
+/// @brief qsort() comparison function for latencies
+static int lat_cmp(const void *a, const void *b)
+{
+  uint32_t la = *(uint32_t*)a, lb = *(uint32_t*)b;
+  return (la > lb) - (la < lb);
+}
+
+/// @brief a replaying thread (threaded replay)
+struct Worker {
+  struct Impl *impl;                                  ///< implementation
+  struct Trace *t;                                    ///< script
+  pthread_barrier_t *start;                           ///< released when all threads are ready
+  void **ptr;                                         ///< the thread's blocks
+  struct timespec t0, t1;                             ///< start/end of the thread's replay
+};
+
+/// @brief replay a trace in a worker thread
+static void* worker(void *arg)
+{
+  struct Worker *w = arg;
+
+  pthread_barrier_wait(w->start);
+  clock_gettime(CLOCK_MONOTONIC, &w->t0);
+  for (size_t i = 0; i < w->t->nops; i++) execute(w->impl, &w->t->ops[i], w->ptr);
+  clock_gettime(CLOCK_MONOTONIC, &w->t1);
+  release_all(w->impl, w->t, w->ptr);
+
+  return NULL;
+}
+
+/// @brief replay trace @a t concurrently in s->threads threads on @a impl and print the aggregate
+///        throughput
+static void run_threads(struct Settings *s, struct Trace *t, struct Impl *impl, FreelistPolicy fp,
+                        const char *policy, size_t check_errors)
+{
+  int n = s->threads;
+  struct Worker *w = bench_alloc(n * sizeof(struct Worker));
+  pthread_t *tid = bench_alloc(n * sizeof(pthread_t));
+  pthread_barrier_t start;
+
+  pthread_barrier_init(&start, NULL, n + 1);
+
+  impl->init(s, t, fp);
+  for (int i = 0; i < n; i++) {
+    w[i] = (struct Worker){ impl, t, &start, bench_alloc(t->nids * sizeof(void*)) };
+    if (pthread_create(&tid[i], NULL, worker, &w[i]) != 0) panic("Cannot create thread", t->name);
+  }
+
+  // each thread times its own replay (without the teardown). The measured interval runs from
+  // the first thread's start to the last thread's end
+  pthread_barrier_wait(&start);
+  for (int i = 0; i < n; i++) pthread_join(tid[i], NULL);
+
+  struct timespec t0 = w[0].t0, t1 = w[0].t1;
+  for (int i = 1; i < n; i++) {
+    if (ts_before(&w[i].t0, &t0)) t0 = w[i].t0;
+    if (ts_before(&t1, &w[i].t1)) t1 = w[i].t1;
+  }
+
+  size_t errors = impl->errors();
+  impl->fini();
+
+  double sec = elapsed(&t0, &t1) / 1e9;
+  size_t nops = t->nops * n;
+
+  printf("%-20s %-7s %-9s %10lu %11.2f %7s", t->name, impl->name, policy, nops,
+         sec > 0 ? nops / sec / 1000 : 0.0, "n/a");
+  printf(" %7s %7s %7s %8s %9s %9s %9s", "-", "-", "-", "-", "-", "-", "-");
+  if (errors) printf("  (%lu heap errors)", errors);
+  if (check_errors) printf("  (%lu check errors)", check_errors);
+  printf("\n");
+  fflush(stdout);
+
+  pthread_barrier_destroy(&start);
+  for (int i = 0; i < n; i++) bench_free(w[i].ptr);
+  bench_free(tid);
+  bench_free(w);
+}
+
+/// @brief replay trace @a t twice on @a impl (throughput; latency & utilization) and print results
+static void run(struct Settings *s, struct Trace *t, struct Impl *impl, FreelistPolicy fp,
+                const char *policy)
+{
+  // pass 0 (correctness mode): validation
+  size_t check_errors = 0;
+  if ((t->correctness || s->check) && (impl->inheap != NULL)) {
+    check_errors = validate(s, t, impl, fp);
+    total_errors += check_errors;
+  }
+
+  if (s->threads > 1) {
+    run_threads(s, t, impl, fp, policy, check_errors);
+    return;
+  }
+
+  void **ptr = bench_alloc(t->nids * sizeof(void*));
+  size_t *size = bench_alloc(t->nids * sizeof(size_t));
+  uint32_t *lat = bench_alloc(t->nops * sizeof(uint32_t));
+
+  struct timespec t0, t1;
+
+  // pass 1: throughput. The start-up time includes setting up the data segment
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  impl->init(s, t, fp);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  uint64_t startup = elapsed(&t0, &t1);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (size_t i = 0; i < t->nops; i++) execute(impl, &t->ops[i], ptr);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  release_all(impl, t, ptr);
+  impl->fini();
+
+  double sec = elapsed(&t0, &t1) / 1e9;
+
+  // pass 2: latency and utilization
+  size_t payload = 0, peak_payload = 0, peak_footprint = 0, failed = 0;
+
+  impl->init(s, t, fp);
+  for (size_t i = 0; i < t->nops; i++) {
+    struct Op *op = &t->ops[i];
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    execute(impl, op, ptr);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    lat[i] = elapsed(&t0, &t1);
+
+    // track live payload; sample the footprint at every new payload peak and periodically
+    if (op->id == NULL_ID) continue;
+    payload -= size[op->id];
+    size[op->id] = (ptr[op->id] != NULL) ? op->size : 0;
+    payload += size[op->id];
+    if ((op->type != 'f') && (op->size > 0) && (ptr[op->id] == NULL)) failed++;
+
+    if ((payload > peak_payload) || ((i & 1023) == 0)) {
+      if (payload > peak_payload) peak_payload = payload;
+      size_t footprint = impl->footprint();
+      if (footprint > peak_footprint) peak_footprint = footprint;
+    }
+  }
+  size_t fp_end = impl->footprint();
+  if (fp_end > peak_footprint) peak_footprint = fp_end;
+  size_t errors = impl->errors();
+  size_t rss = impl->rss();
+  release_all(impl, t, ptr);
+  impl->fini();
+
+  qsort(lat, t->nops, sizeof(uint32_t), lat_cmp);
+  #define PCT(q) (t->nops ? lat[(size_t)((q) * (t->nops - 1))] : 0)
+
+  printf("%-20s %-7s %-9s %10lu %11.2f ", t->name, impl->name, policy, t->nops,
+         sec > 0 ? t->nops / sec / 1000 : 0.0);
+  if (peak_footprint > 0) printf("%6.1f%% ", 100.0 * peak_payload / peak_footprint);
+  else printf("%7s ", "n/a");
+  printf("%7u %7u %7u %8u %9u", PCT(0.5), PCT(0.9), PCT(0.99), PCT(0.999), PCT(1.0));
+  printf(" %9.1f", startup / 1e3);
+  if (rss > 0) printf(" %9lu", rss >> 10);
+  else printf(" %9s", "-");
+  if (failed) printf("  (%lu failed)", failed);
+  if (errors) printf("  (%lu heap errors)", errors);
+  if (check_errors) printf("  (%lu check errors)", check_errors);
+  printf("\n");
+  fflush(stdout);
+
+  #undef PCT
+
+  bench_free(lat);
+  bench_free(size);
+  bench_free(ptr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Main
+//
+
+static void syntax(const char *prg)
+{
+  printf("Syntax: %s [options] <script(s)>\n"
+         "\n"
+         "  --dssize <size>            set size of datasegment to <size>\n"
+         "  --implementation <list>    comma-separated list of implementations\n"
+         "                               memmgr, libc, null (default: all)\n"
+         "  --policy <list>            comma-separated list of freelist policies for memmgr\n"
+         "                               implicit, explicit, tlsf, splay,\n"
+         "                               first, next, best, good (address-ordered), bitmap,\n"
+         "                               all\n"
+         "                               (default: policy given in script)\n"
+         "  --nofooter                 no footers in allocated blocks (mm_setfooter(0))\n"
+         "  --slab                     turn on slab front-end (mm_setslab(1))\n"
+         "  --quickbins                turn on quick bins (mm_setquickbins(1))\n"
+         "  --mmap <size>              mmap requests of <size> bytes or more (mm_setmmap())\n"
+         "  --goodfit <percent>        good fit tolerance (mm_setgoodfit(), default: 25)\n"
+         "  --lazy                     reserve the data segment lazily (ds_setlazy(1))\n"
+         "  --hugepages                back the heap with huge pages (ds_sethugepages(1))\n"
+         "  --verify <n>[,<window>]    verify heap every <n> operations (mm_setverify())\n"
+         "  --check                    validate payloads and block placement in all scripts\n"
+         "                               (default: scripts in correctness mode only)\n"
+         "  --threads <n>              replay the script in <n> threads concurrently and\n"
+         "                               report the aggregate throughput only\n"
+         "  --arenas <n>               number of arenas with --threads (mm_setarenas(),\n"
+         "                               default: one per thread)\n"
+         "  --help                     this screen\n"
+         "\n"
+         "Reports throughput, peak utilization, and latency percentiles (in ns) per operation.\n",
+         prg);
+  exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+  struct Settings s = { .dssize = 0, .impl = { 1, 1, 1 }, .footer = 1, .goodfit = 25 };
+  int nscripts = 0, custom_policy = 0;
+
+  for (int i = 1; i < argc; i++) {
+    char *a = argv[i];
+    int has_arg = (i + 1 < argc);
+
+    if (strcmp(a, "--help") == 0) {
+      syntax(argv[0]);
+    } else if ((strcmp(a, "--dssize") == 0) && has_arg) {
+      s.dssize = strtoul(argv[++i], NULL, 0);
+      if (s.dssize == 0) panic("Invalid data segment size", argv[i]);
+    } else if ((strcmp(a, "--implementation") == 0) && has_arg) {
+      memset(s.impl, 0, sizeof(s.impl));
+      for (char *tok = strtok(argv[++i], ","); tok != NULL; tok = strtok(NULL, ",")) {
+        int found = 0;
+        for (int j = 0; j < 3; j++) {
+          if (strcmp(tok, impls[j].name) == 0) s.impl[j] = found = 1;
+        }
+        if (!found) panic("Invalid implementation", tok);
+      }
+    } else if ((strcmp(a, "--policy") == 0) && has_arg) {
+      custom_policy = 1;
+      for (char *tok = strtok(argv[++i], ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (strcmp(tok, "all") == 0) {
+          for (int j = 0; j < NPOLICIES; j++) s.policy[j] = 1;
+        } else {
+          int p = parse_policy(tok);
+          if (p < 0) panic("Invalid policy", tok);
+          s.policy[p] = 1;
+        }
+      }
+    } else if (strcmp(a, "--nofooter") == 0) {
+      s.footer = 0;
+    } else if (strcmp(a, "--slab") == 0) {
+      s.slab = 1;
+    } else if (strcmp(a, "--quickbins") == 0) {
+      s.quick = 1;
+    } else if ((strcmp(a, "--mmap") == 0) && has_arg) {
+      s.mmap = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(a, "--lazy") == 0) {
+      s.lazy = 1;
+    } else if (strcmp(a, "--hugepages") == 0) {
+      s.hugepages = 1;
+    } else if ((strcmp(a, "--goodfit") == 0) && has_arg) {
+      s.goodfit = strtoul(argv[++i], NULL, 0);
+    } else if ((strcmp(a, "--verify") == 0) && has_arg) {
+      char *end;
+      s.verify = strtoul(argv[++i], &end, 0);
+      if (*end == ',') s.window = strtoul(end + 1, NULL, 0);
+    } else if (strcmp(a, "--check") == 0) {
+      s.check = 1;
+    } else if ((strcmp(a, "--threads") == 0) && has_arg) {
+      s.threads = atoi(argv[++i]);
+      if (s.threads < 1) panic("Invalid number of threads", argv[i]);
+    } else if ((strcmp(a, "--arenas") == 0) && has_arg) {
+      s.arenas = atoi(argv[++i]);
+      if (s.arenas < 1) panic("Invalid number of arenas", argv[i]);
+    } else if (a[0] == '-') {
+      panic("Invalid or incomplete option", a);
+    } else {
+      argv[++nscripts] = a;
+    }
+  }
+
+  if (nscripts == 0) syntax(argv[0]);
+  if (s.arenas == 0) s.arenas = s.threads;
+
+  printf("%-20s %-7s %-9s %10s %11s %7s %7s %7s %7s %8s %9s %9s %9s\n",
+         "script", "impl", "policy", "ops", "kops/sec", "util",
+         "p50", "p90", "p99", "p99.9", "max", "init(us)", "rss(KB)");
+
+  for (int n = 1; n <= nscripts; n++) {
+    struct Trace t;
+    read_trace(argv[n], &t);
+
+    for (int j = 0; j < 3; j++) {
+      if (!s.impl[j]) continue;
+
+      if (&impls[j] != &impls[0]) {
+        run(&s, &t, &impls[j], t.policy, "-");
+      } else if (!custom_policy) {
+        run(&s, &t, &impls[j], t.policy, policy_names[t.policy]);
+      } else {
+        for (int p = 0; p < NPOLICIES; p++) {
+          if (s.policy[p]) run(&s, &t, &impls[j], p, policy_names[p]);
+        }
+      }
+    }
+
+    bench_free(t.ops);
+  }
+
+  return total_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
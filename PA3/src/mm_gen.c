@@ -0,0 +1,463 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                       Memory Lab                                   Spring 2024
+//
+/// @file
+/// @brief synthetic allocation trace generator
+///
+/// @section license_section License
+/// Copyright (c) 2020-2023, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED  TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)   HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+//
+// Trace generator
+// ===============
+// mm_gen writes synthetic .dmas scripts of arbitrary length (tens of millions of operations are
+// no problem) for mm_driver and mm_bench.
+//
+// The generator simulates a program with a logical clock that advances by one per operation. At
+// every tick, the object with the earliest pending event is serviced if its event is due,
+// otherwise a new object is allocated. Freed ids are reused, so the id space stays proportional
+// to the number of live objects.
+//
+// Object sizes are drawn from one of the following distributions
+//   - uniform:   uniformly distributed in [min, max]
+//   - powerlaw:  Pareto distribution with shape alpha starting at min, clamped to max. Many small
+//                objects and a heavy tail of large ones.
+//   - bimodal:   small objects (around --small) mixed with a fraction of large objects (around
+//                --large); +/-50% jitter.
+//
+// Lifetimes (in operations) are exponentially distributed. A fraction of objects is short-lived,
+// the others are long-lived, each with its own mean lifetime.
+//
+// Realloc growth chains model growing buffers (vectors, string builders): a fraction of the
+// objects is reallocated a geometric number of times, each time growing by a constant factor,
+// before its regular lifetime starts.
+//
+// Phase changes: the trace is split into equally long phases that cycle through the size
+// distributions given with --size. Long-lived objects survive phase boundaries and fragment the
+// heap for the following phase.
+//
+// The simulation is deterministic for a given seed. It is run twice: the first run computes the
+// peak live payload to size the data segment, the second one writes the script. With --drain, all
+// objects still live at the end are freed so that the script leaves an empty heap.
+//
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// @brief size distributions
+enum SizeDist { sd_Uniform, sd_PowerLaw, sd_Bimodal, sd_Count };
+
+static const char *dist_names[] = { "uniform", "powerlaw", "bimodal" };
+
+/// @brief generator settings
+struct Settings {
+  uint64_t ops;                                       ///< number of operations before draining
+  uint64_t seed;                                      ///< random seed
+  int dist[16];                                       ///< size distribution per phase (cycled)
+  int ndist;                                          ///< number of entries in dist
+  int phases;                                         ///< number of phases
+  size_t min, max;                                    ///< size bounds
+  double alpha;                                       ///< power-law shape
+  size_t small, large;                                ///< bimodal centers
+  double large_frac;                                  ///< bimodal: fraction of large objects
+  double short_frac;                                  ///< fraction of short-lived objects
+  double short_life, long_life;                       ///< mean lifetimes in operations
+  double realloc_frac;                                ///< fraction of objects in realloc chains
+  double realloc_steps;                               ///< mean number of reallocs in a chain
+  double growth;                                      ///< growth factor per realloc
+  double calloc_frac;                                 ///< fraction of allocations using calloc
+  size_t dssize;                                      ///< data segment size (0: auto)
+  const char *policy;                                 ///< heap policy written to script
+  int drain;                                          ///< free all live objects at the end
+};
+
+/// @brief a live object
+struct Object {
+  uint32_t size;                                      ///< current size
+  uint32_t steps;                                     ///< remaining reallocs
+};
+
+/// @brief a pending event (realloc or free) in the event queue
+struct Event {
+  uint64_t time;                                      ///< due time
+  uint32_t id;                                        ///< object
+};
+
+/// @brief generator state
+struct Generator {
+  struct Settings *s;                                 ///< settings
+  FILE *out;                                          ///< output (NULL: simulate only)
+  uint64_t rng;                                       ///< xorshift64* state
+  uint64_t now;                                       ///< logical clock
+  struct Object *obj;                                 ///< objects by id
+  uint32_t *free_ids;                                 ///< stack of unused ids
+  uint32_t nfree, nids, cap;                          ///< free id stack size, ids used, capacity
+  struct Event *heap;                                 ///< event queue (binary min-heap)
+  uint32_t nevents;                                   ///< number of pending events
+  size_t live, peak;                                  ///< live payload, peak live payload
+  uint64_t count[4];                                  ///< emitted m, c, r, f
+};
+
+
+/// @brief print an error message and exit
+static void panic(const char *msg, const char *arg)
+{
+  fprintf(stderr, "ERROR: %s '%s'.\n", msg, arg);
+  exit(EXIT_FAILURE);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Random numbers
+//
+
+/// @brief uniformly distributed 64-bit random number (xorshift64*)
+static inline uint64_t rnd(struct Generator *g)
+{
+  g->rng ^= g->rng >> 12;
+  g->rng ^= g->rng << 25;
+  g->rng ^= g->rng >> 27;
+  return g->rng * 0x2545F4914F6CDD1DULL;
+}
+
+/// @brief uniformly distributed random number in [0, 1)
+static inline double rnd_unit(struct Generator *g)
+{
+  return (rnd(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/// @brief exponentially distributed random number with mean @a mean
+static inline double rnd_exp(struct Generator *g, double mean)
+{
+  return -mean * log(1.0 - rnd_unit(g));
+}
+
+/// @brief draw an object size from distribution @a dist
+static size_t draw_size(struct Generator *g, int dist)
+{
+  struct Settings *s = g->s;
+  double size;
+
+  switch (dist) {
+    case sd_PowerLaw:
+      size = s->min * pow(1.0 - rnd_unit(g), -1.0 / s->alpha);
+      break;
+
+    case sd_Bimodal: {
+      double center = (rnd_unit(g) < s->large_frac) ? s->large : s->small;
+      size = center * (0.5 + rnd_unit(g));
+      break;
+    }
+
+    default:
+      size = s->min + rnd_unit(g) * (s->max - s->min + 1);
+      break;
+  }
+
+  if (size < s->min) size = s->min;
+  if (size > s->max) size = s->max;
+  return (size_t)size;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Event queue
+//
+
+/// @brief schedule an event for object @a id at time @a time
+static void push_event(struct Generator *g, uint64_t time, uint32_t id)
+{
+  uint32_t i = g->nevents++;
+  while (i > 0) {
+    uint32_t parent = (i - 1) / 2;
+    if (g->heap[parent].time <= time) break;
+    g->heap[i] = g->heap[parent];
+    i = parent;
+  }
+  g->heap[i] = (struct Event){ time, id };
+}
+
+/// @brief remove the earliest event from the queue
+static struct Event pop_event(struct Generator *g)
+{
+  struct Event top = g->heap[0], last = g->heap[--g->nevents];
+  uint32_t i = 0, n = g->nevents;
+
+  while (2*i + 1 < n) {
+    uint32_t c = 2*i + 1;
+    if ((c + 1 < n) && (g->heap[c+1].time < g->heap[c].time)) c++;
+    if (last.time <= g->heap[c].time) break;
+    g->heap[i] = g->heap[c];
+    i = c;
+  }
+  if (n > 0) g->heap[i] = last;
+
+  return top;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Simulation
+//
+
+/// @brief emit operation @a type on object @a id
+static inline void emit(struct Generator *g, char type, uint32_t id, size_t size)
+{
+  g->count[type == 'm' ? 0 : type == 'c' ? 1 : type == 'r' ? 2 : 3]++;
+  if (g->out == NULL) return;
+
+  if (type == 'f') fprintf(g->out, "f %u\n", id);
+  else fprintf(g->out, "%c %u %lu\n", type, id, size);
+}
+
+/// @brief schedule the regular (free) event of object @a id
+static void schedule_free(struct Generator *g, uint32_t id)
+{
+  struct Settings *s = g->s;
+  double mean = (rnd_unit(g) < s->short_frac) ? s->short_life : s->long_life;
+  push_event(g, g->now + 1 + (uint64_t)rnd_exp(g, mean), id);
+}
+
+/// @brief allocate a new object with a size drawn from distribution @a dist
+static void allocate(struct Generator *g, int dist)
+{
+  struct Settings *s = g->s;
+  uint32_t id;
+
+  if (g->nfree > 0) {
+    id = g->free_ids[--g->nfree];
+  } else {
+    if (g->nids == g->cap) {
+      g->cap = g->cap ? 2*g->cap : 4096;
+      g->obj = realloc(g->obj, g->cap * sizeof(struct Object));
+      g->free_ids = realloc(g->free_ids, g->cap * sizeof(uint32_t));
+      g->heap = realloc(g->heap, g->cap * sizeof(struct Event));
+      if ((g->obj == NULL) || (g->free_ids == NULL) || (g->heap == NULL)) {
+        panic("Out of memory", "allocate");
+      }
+    }
+    id = g->nids++;
+  }
+
+  struct Object *o = &g->obj[id];
+  o->size = draw_size(g, dist);
+  o->steps = 0;
+
+  emit(g, (rnd_unit(g) < s->calloc_frac) ? 'c' : 'm', id, o->size);
+  g->live += o->size;
+
+  if (rnd_unit(g) < s->realloc_frac) {
+    o->steps = 1 + (uint32_t)rnd_exp(g, s->realloc_steps);
+    push_event(g, g->now + 1 + (uint64_t)rnd_exp(g, s->short_life), id);
+  } else {
+    schedule_free(g, id);
+  }
+}
+
+/// @brief service event @a e: grow a realloc chain or free the object
+static void service(struct Generator *g, struct Event e)
+{
+  struct Settings *s = g->s;
+  struct Object *o = &g->obj[e.id];
+
+  g->live -= o->size;
+
+  if (o->steps > 0) {
+    double size = o->size * s->growth;
+    o->size = (size > s->max) ? s->max : (uint32_t)size;
+    o->steps--;
+    emit(g, 'r', e.id, o->size);
+    g->live += o->size;
+
+    if (o->steps > 0) push_event(g, g->now + 1 + (uint64_t)rnd_exp(g, s->short_life), e.id);
+    else schedule_free(g, e.id);
+  } else {
+    emit(g, 'f', e.id, 0);
+    g->free_ids[g->nfree++] = e.id;
+  }
+}
+
+/// @brief run the simulation; write the script body to @a out unless it is NULL
+static void simulate(struct Generator *g, struct Settings *s, FILE *out)
+{
+  memset(g, 0, sizeof(*g));
+  g->s = s;
+  g->out = out;
+  g->rng = s->seed ? s->seed : 1;
+
+  uint64_t phase_len = (s->ops + s->phases - 1) / s->phases;
+
+  for (g->now = 0; g->now < s->ops; g->now++) {
+    if ((g->nevents > 0) && (g->heap[0].time <= g->now)) {
+      service(g, pop_event(g));
+    } else {
+      allocate(g, s->dist[(g->now / phase_len) % s->ndist]);
+    }
+    if (g->live > g->peak) g->peak = g->live;
+  }
+
+  // free all remaining objects in the order of their events
+  while (s->drain && (g->nevents > 0)) {
+    struct Event e = pop_event(g);
+    g->obj[e.id].steps = 0;
+    service(g, e);
+  }
+
+  free(g->heap);
+  free(g->free_ids);
+  free(g->obj);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Main
+//
+
+static void syntax(const char *prg)
+{
+  printf("Syntax: %s [options] <output.dmas>\n"
+         "\n"
+         "  --ops <n>                  number of operations (default: 10000000)\n"
+         "  --seed <n>                 random seed (default: 1)\n"
+         "  --size <list>              comma-separated size distributions, one per phase\n"
+         "                               uniform, powerlaw, bimodal (default: powerlaw)\n"
+         "  --phases <n>               number of phases (default: number of distributions)\n"
+         "  --min <size>               minimal object size (default: 8)\n"
+         "  --max <size>               maximal object size (default: 1048576)\n"
+         "  --alpha <f>                power-law shape (default: 1.2)\n"
+         "  --small <size>             bimodal: small object size (default: 32)\n"
+         "  --large <size>             bimodal: large object size (default: 4096)\n"
+         "  --large-frac <f>           bimodal: fraction of large objects (default: 0.1)\n"
+         "  --short-frac <f>           fraction of short-lived objects (default: 0.9)\n"
+         "  --short-life <n>           mean lifetime of short-lived objects (default: 100)\n"
+         "  --long-life <n>            mean lifetime of long-lived objects (default: 100000)\n"
+         "  --realloc-frac <f>         fraction of objects in realloc chains (default: 0.05)\n"
+         "  --realloc-steps <n>        mean number of reallocs per chain (default: 4)\n"
+         "  --growth <f>               growth factor per realloc (default: 2.0)\n"
+         "  --calloc-frac <f>          fraction of allocations using calloc (default: 0.0)\n"
+         "  --dssize <size>            data segment size (default: based on peak payload)\n"
+         "  --policy <policy>          heap policy written to the script (default: explicit)\n"
+         "  --drain                    free all live objects at the end of the script\n"
+         "  --help                     this screen\n"
+         "\n"
+         "Use '-' as output to write to stdout.\n",
+         prg);
+  exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+  struct Settings s = {
+    .ops = 10000000, .seed = 1, .dist = { sd_PowerLaw }, .ndist = 1, .phases = 0,
+    .min = 8, .max = 1 << 20, .alpha = 1.2, .small = 32, .large = 4096, .large_frac = 0.1,
+    .short_frac = 0.9, .short_life = 100, .long_life = 100000,
+    .realloc_frac = 0.05, .realloc_steps = 4, .growth = 2.0, .calloc_frac = 0.0,
+    .dssize = 0, .policy = "explicit",
+  };
+  const char *fn = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    char *a = argv[i];
+    char *v = (i + 1 < argc) ? argv[i+1] : NULL;
+
+    if (strcmp(a, "--help") == 0) syntax(argv[0]);
+    else if (strcmp(a, "--drain") == 0) { s.drain = 1; continue; }
+    else if ((a[0] == '-') && (a[1] == '-') && (v == NULL)) panic("Incomplete option", a);
+    else if (strcmp(a, "--ops") == 0) s.ops = strtoull(v, NULL, 0);
+    else if (strcmp(a, "--seed") == 0) s.seed = strtoull(v, NULL, 0);
+    else if (strcmp(a, "--phases") == 0) s.phases = atoi(v);
+    else if (strcmp(a, "--min") == 0) s.min = strtoul(v, NULL, 0);
+    else if (strcmp(a, "--max") == 0) s.max = strtoul(v, NULL, 0);
+    else if (strcmp(a, "--alpha") == 0) s.alpha = atof(v);
+    else if (strcmp(a, "--small") == 0) s.small = strtoul(v, NULL, 0);
+    else if (strcmp(a, "--large") == 0) s.large = strtoul(v, NULL, 0);
+    else if (strcmp(a, "--large-frac") == 0) s.large_frac = atof(v);
+    else if (strcmp(a, "--short-frac") == 0) s.short_frac = atof(v);
+    else if (strcmp(a, "--short-life") == 0) s.short_life = atof(v);
+    else if (strcmp(a, "--long-life") == 0) s.long_life = atof(v);
+    else if (strcmp(a, "--realloc-frac") == 0) s.realloc_frac = atof(v);
+    else if (strcmp(a, "--realloc-steps") == 0) s.realloc_steps = atof(v);
+    else if (strcmp(a, "--growth") == 0) s.growth = atof(v);
+    else if (strcmp(a, "--calloc-frac") == 0) s.calloc_frac = atof(v);
+    else if (strcmp(a, "--dssize") == 0) s.dssize = strtoul(v, NULL, 0);
+    else if (strcmp(a, "--policy") == 0) s.policy = v;
+    else if (strcmp(a, "--size") == 0) {
+      s.ndist = 0;
+      char *list = strdup(v);
+      for (char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        int d;
+        for (d = 0; d < sd_Count; d++) if (strcmp(tok, dist_names[d]) == 0) break;
+        if ((d == sd_Count) || (s.ndist == 16)) panic("Invalid size distribution", tok);
+        s.dist[s.ndist++] = d;
+      }
+      if (s.ndist == 0) panic("Invalid size distribution", v);
+      free(list);
+    }
+    else if ((a[0] == '-') && (a[1] != '\0')) panic("Invalid option", a);
+    else { fn = a; continue; }
+    i++;
+  }
+
+  if (fn == NULL) syntax(argv[0]);
+  if (s.phases <= 0) s.phases = s.ndist;
+  if ((s.ops == 0) || (s.min == 0) || (s.min > s.max) || (s.max > UINT32_MAX) ||
+      (s.alpha <= 0) || (s.growth < 1.0)) {
+    panic("Invalid parameters", "see --help");
+  }
+
+  struct Generator g;
+
+  // pass 1: determine peak payload to size the data segment (2x peak, rounded to a power of 2)
+  simulate(&g, &s, NULL);
+  if (s.dssize == 0) {
+    s.dssize = 1 << 24;
+    while (s.dssize < 2*g.peak) s.dssize <<= 1;
+  }
+
+  // pass 2: write script
+  FILE *out = (strcmp(fn, "-") == 0) ? stdout : fopen(fn, "w");
+  if (out == NULL) panic("Cannot open output file", fn);
+  setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+  fprintf(out, "#\n# synthetic trace generated by\n#  ");
+  for (int i = 0; i < argc; i++) fprintf(out, " %s", argv[i]);
+  fprintf(out, "\n#\n# peak payload: %lu bytes\n#\n\n", g.peak);
+  fprintf(out, "dataseg 0x%lx\nheap %s\n\nmode performance\n\nstart\n\n", s.dssize, s.policy);
+
+  simulate(&g, &s, out);
+
+  fprintf(out, "\nstop\nstat\n");
+  if (out != stdout) fclose(out);
+
+  fprintf(stderr, "%s: %lu ops (%lu malloc, %lu calloc, %lu realloc, %lu free), "
+          "%u ids, peak payload %lu bytes\n",
+          fn, g.count[0] + g.count[1] + g.count[2] + g.count[3],
+          g.count[0], g.count[1], g.count[2], g.count[3], g.nids, g.peak);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,329 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                       Memory Lab                                   Spring 2024
+//
+/// @file
+/// @brief malloc-compatible shim for the dynamic memory manager (LD_PRELOAD)
+///
+/// @section license_section License
+/// Copyright (c) 2020-2023, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED  TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT, INCIDENTAL,  SPECIAL,  EXEMPLARY,  OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)   HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+//
+// Preload shim
+// ============
+// libmm.so replaces the C library's allocator with our memory manager:
+//
+//   $ LD_PRELOAD=./libmm.so ls -l
+//
+// It exports malloc, free, calloc, realloc, reallocarray, posix_memalign, memalign,
+// aligned_alloc, valloc, pvalloc, and malloc_usable_size. All of them must be replaced, since
+// the C library's versions would otherwise hand out blocks from its own heap that end up in our
+// free().
+//
+// Initialization:
+// ---------------
+// The data segment and the heap are set up by the first allocation. The thread that gets there
+// first initializes; other threads wait until it is done. Allocations made by the initializing
+// thread itself while it is initializing (i.e., recursively) are served from a small static
+// bootstrap area. Bootstrap blocks are never released: free() ignores them and realloc() moves
+// them to the heap.
+//
+// The memory manager is configured with environment variables:
+//   MM_POLICY    free list policy (implicit, explicit, tlsf (default), splay, first, next, best,
+//                good, bitmap)
+//   MM_DATASEG   size of the data segment in bytes (default: 1 GB, reserved lazily; < 4 GB)
+//   MM_ARENAS    number of arenas (default: 1; 0 is single-threaded mode and only safe for
+//                programs that do not create threads)
+//   MM_MMAP      large object threshold in bytes (default: 128 KB; 0: off)
+//   MM_STATS     if set, print the heap statistics to stderr when the program exits
+//
+// Alignment:
+// -----------
+// malloc(), calloc(), and realloc() must return memory that is suitably aligned for any type, i.e.,
+// to 16 bytes on x86-64 (alignof(max_align_t)). The default build variant only aligns payloads to
+// 8 bytes, so libmm.so is built from the 'g16' variant (16-byte granules and 4-byte tags, see
+// 'Build variants' in memmgr.c), in which all payloads are 16-byte aligned. Every pointer returned
+// by the shim is checked with an assertion. The 32-bit tags limit the data segment to 4 GB;
+// larger values of MM_DATASEG are clamped.
+//
+// Semantics follow glibc: malloc(0) returns a unique pointer, realloc(ptr, 0) frees ptr and
+// returns NULL, and errno is set to ENOMEM when an allocation fails.
+//
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dataseg.h"
+#include "memmgr.h"
+
+#define BOOT_SIZE    (64*1024)                         ///< size of the bootstrap area
+#define BOOT_ALIGN   16                                ///< minimal alignment of bootstrap blocks
+#define MALLOC_ALIGN 16                                ///< alignment guaranteed by malloc()
+#define DATASEG_MAX  (0xffffffffUL & ~0xfffffUL)       ///< largest data segment (32-bit tags)
+
+/// @brief initialization state
+enum { ST_UNINIT, ST_INIT, ST_READY };
+
+static int mmp_state = ST_UNINIT;                      ///< initialization state (atomic)
+static __thread int mmp_initializing                   ///< this thread is initializing
+  __attribute__((tls_model("initial-exec")));
+
+static char boot_area[BOOT_SIZE] __attribute__((aligned(BOOT_ALIGN))); ///< bootstrap area
+static size_t boot_brk = 0;                            ///< bytes used in the bootstrap area
+
+static const char *policy_names[] = {
+  "implicit", "explicit", "tlsf", "splay", "first", "next", "best", "good", "bitmap"
+};
+
+
+/// @brief read a numeric setting from the environment
+/// @param name name of the environment variable
+/// @param def default value if the variable is not set
+static size_t env_size(const char *name, size_t def)
+{
+  const char *v = getenv(name);
+  return (v != NULL) && (*v != '\0') ? strtoul(v, NULL, 0) : def;
+}
+
+/// @brief read the free list policy from the environment (MM_POLICY)
+static FreelistPolicy env_policy(void)
+{
+  const char *v = getenv("MM_POLICY");
+  if (v != NULL) {
+    for (size_t i = 0; i < sizeof(policy_names)/sizeof(policy_names[0]); i++) {
+      if (strcmp(v, policy_names[i]) == 0) return (FreelistPolicy)i;
+    }
+  }
+  return fp_TLSF;
+}
+
+/// @brief print the heap statistics when the program exits (MM_STATS)
+static void print_stats(void)
+{
+  struct mm_stats s;
+  mm_stats(&s);
+
+  fprintf(stderr, "mm: heap %lu (peak %lu) bytes, %lu allocated, %lu free in %lu blocks, "
+          "%lu mmapped in %lu objects, %lu sbrk calls\n",
+          s.heap_size, s.heap_peak, s.alloc_bytes, s.free_bytes, s.free_blocks,
+          s.mmap_bytes, s.mmap_objects, s.sbrk_calls);
+}
+
+/// @brief make sure the memory manager is initialized
+/// @retval 1 if the heap can be used
+/// @retval 0 if the calling thread is initializing the heap (use the bootstrap area)
+static int mmp_init(void)
+{
+  if (__atomic_load_n(&mmp_state, __ATOMIC_ACQUIRE) == ST_READY) return 1;
+  if (mmp_initializing) return 0;
+
+  int state = ST_UNINIT;
+  if (!__atomic_compare_exchange_n(&mmp_state, &state, ST_INIT, 0,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+    // another thread is initializing
+    while (__atomic_load_n(&mmp_state, __ATOMIC_ACQUIRE) != ST_READY) sched_yield();
+    return 1;
+  }
+
+  mmp_initializing = 1;
+
+  ds_setlazy(1);
+  size_t dssize = env_size("MM_DATASEG", 1UL << 30);
+  ds_allocate(dssize < DATASEG_MAX ? dssize : DATASEG_MAX);
+  mm_setarenas((int)env_size("MM_ARENAS", 1));
+  mm_setmmap(env_size("MM_MMAP", 128*1024));
+  mm_init(env_policy());
+
+  if (getenv("MM_STATS") != NULL) atexit(print_stats);
+
+  mmp_initializing = 0;
+  __atomic_store_n(&mmp_state, ST_READY, __ATOMIC_RELEASE);
+
+  return 1;
+}
+
+
+/// @brief allocate a block from the bootstrap area. The size of the block is stored in the word
+///        preceding the block.
+/// @param alignment alignment in bytes (power of two)
+/// @param size requested size in bytes
+static void* boot_alloc(size_t alignment, size_t size)
+{
+  if (alignment < BOOT_ALIGN) alignment = BOOT_ALIGN;
+
+  size_t start = (boot_brk + sizeof(size_t) + alignment-1) & ~(alignment-1);
+  if ((start > BOOT_SIZE) || (size > BOOT_SIZE - start)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  boot_brk = start + size;
+  ((size_t*)&boot_area[start])[-1] = size;
+
+  return &boot_area[start];
+}
+
+/// @brief check that @a ptr satisfies the alignment guaranteed by malloc()
+/// @param ptr pointer returned by the memory manager (may be NULL)
+static void* check_align(void *ptr)
+{
+  assert(((uintptr_t)ptr & (MALLOC_ALIGN-1)) == 0);
+  return ptr;
+}
+
+/// @brief check whether @a ptr was allocated from the bootstrap area
+static int is_boot(void *ptr)
+{
+  return ((char*)ptr >= boot_area) && ((char*)ptr < boot_area + BOOT_SIZE);
+}
+
+/// @brief size of bootstrap block @a ptr
+static size_t boot_size(void *ptr)
+{
+  return ((size_t*)ptr)[-1];
+}
+
+
+void* malloc(size_t size)
+{
+  if (!mmp_init()) return boot_alloc(0, size);
+
+  void *ptr = mm_malloc(size ? size : 1);
+  if (ptr == NULL) errno = ENOMEM;
+  return check_align(ptr);
+}
+
+void free(void *ptr)
+{
+  if ((ptr == NULL) || is_boot(ptr)) return;
+
+  mm_free(ptr);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+  size_t bytes;
+  if (__builtin_mul_overflow(nmemb, size, &bytes)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  // the bootstrap area is never reused and thus still zeroed
+  if (!mmp_init()) return boot_alloc(0, bytes);
+
+  void *ptr = mm_calloc(1, bytes ? bytes : 1);
+  if (ptr == NULL) errno = ENOMEM;
+  return check_align(ptr);
+}
+
+void* realloc(void *ptr, size_t size)
+{
+  if (ptr == NULL) return malloc(size);
+  if (size == 0) { free(ptr); return NULL; }
+
+  // move bootstrap blocks to the heap (or to a new bootstrap block while initializing)
+  if (is_boot(ptr)) {
+    void *new_ptr = malloc(size);
+    if (new_ptr != NULL) memcpy(new_ptr, ptr, boot_size(ptr) < size ? boot_size(ptr) : size);
+    return new_ptr;
+  }
+
+  void *new_ptr = mm_realloc(ptr, size);
+  if (new_ptr == NULL) errno = ENOMEM;
+  return check_align(new_ptr);
+}
+
+void* reallocarray(void *ptr, size_t nmemb, size_t size)
+{
+  size_t bytes;
+  if (__builtin_mul_overflow(nmemb, size, &bytes)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  return realloc(ptr, bytes);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+  if ((alignment == 0) || (alignment & (alignment-1))) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (!mmp_init()) return boot_alloc(alignment, size);
+
+  void *ptr = mm_memalign(alignment, size ? size : 1);
+  if (ptr == NULL) errno = ENOMEM;
+  return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+  if ((alignment == 0) || (alignment % sizeof(void*)) || (alignment & (alignment-1))) return EINVAL;
+
+  int err = errno;
+  void *ptr = memalign(alignment, size);
+  if (ptr == NULL) return ENOMEM;
+  errno = err;
+
+  *memptr = ptr;
+  return 0;
+}
+
+void* valloc(size_t size)
+{
+  return memalign(getpagesize(), size);
+}
+
+void* pvalloc(size_t size)
+{
+  size_t pagesize = getpagesize();
+  if (size > SIZE_MAX - pagesize) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  return memalign(pagesize, (size + pagesize-1) & ~(pagesize-1));
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+  if (ptr == NULL) return 0;
+  if (is_boot(ptr)) return boot_size(ptr);
+
+  return mm_usable_size(ptr);
+}
@@ -134,6 +134,13 @@ int main(int argc, char *argv[])
            "  Select freelist policy.\n"
            "(i) implicit list\n"
            "(e) explicit list\n"
+           "(t) TLSF\n"
+           "(s) splay tree\n"
+           "(f) address-ordered list, first fit\n"
+           "(n) address-ordered list, next fit\n"
+           "(b) address-ordered list, best fit\n"
+           "(g) address-ordered list, good fit\n"
+           "(m) granule bitmap\n"
            "(q) quit\n"
            "Your selection: ");
     fflush(stdout);
@@ -143,13 +150,21 @@ int main(int argc, char *argv[])
       switch (c) {
         case 'i': fp = fp_Implicit; break;
         case 'e': fp = fp_Explicit; break;
+        case 't': fp = fp_TLSF; break;
+        case 's': fp = fp_SplayTree; break;
+        case 'f': fp = fp_FirstFit; break;
+        case 'n': fp = fp_NextFit; break;
+        case 'b': fp = fp_BestFit; break;
+        case 'g': fp = fp_GoodFit; break;
+        case 'm': fp = fp_Bitmap; break;
         case 'q': return EXIT_SUCCESS;
         default:  if (c > ' ') printf("Invalid selection.\n");
       }
     } else {
       printf("Error reading character.\n");
     }
-  } while (c != 'i' && c != 'e');
+  } while (c != 'i' && c != 'e' && c != 't' && c != 's' &&
+           c != 'f' && c != 'n' && c != 'b' && c != 'g' && c != 'm');
 
   printf("\n\n\n----------------------------------------\n"
          "  Initializing heap...\n"